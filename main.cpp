@@ -1,22 +1,149 @@
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <random>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <psapi.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <GL/freeglut_std.h>
 #include <GL/gl.h>
 
-const double PI = 3.1416;
+constexpr double PI = 3.1416;
 const int WIDTH = 1200;
 const int HEIGHT = 800;
-const int MAX_ENEMIES = 4;
+const int MAX_ENEMIES = 1024; // capacity; enemyCount cars are in play
+const int MAX_PLAYERS = 4;
+
+// Small PCG32 engine: 16 bytes of state, so snapshots and replay keyframes can store it verbatim
+struct Pcg32 {
+    using result_type = uint32_t;
+
+    uint64_t state = 0x853c49e6748fea9bULL;
+    uint64_t inc = 0xda3e39cb94b95bdbULL;
+
+    void seed(uint64_t s, uint64_t stream = 54) {
+        state = 0;
+        inc = (stream << 1u) | 1u;
+        (*this)();
+        state += s;
+        (*this)();
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT32_MAX; }
+
+    result_type operator()() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + inc;
+        auto xorshifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+        auto rot = static_cast<uint32_t>(old >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+};
+
+// Simulation coordinates: positions, road scrolling and the collision bounds they are tested against. Doubles by
+// default; with CARRACE_FIXED_POINT, Q16.16 integers, so every update and overlap test is integer arithmetic that
+// comes out bit-identical whatever the compiler, optimization level or -ffast-math, and the state is half the size.
+// A Coord reads as a double wherever it is drawn. Updates stay in Coord arithmetic: constants are written
+// Coord{0.01}, and mixing in a plain double yields a double, which does not convert back implicitly.
+#ifdef CARRACE_FIXED_POINT
+struct Fixed {
+    static constexpr double ONE = 1 << 16;
+    int32_t raw;
+
+    Fixed() = default;
+    constexpr explicit Fixed(double v) : raw(static_cast<int32_t>(v * ONE + (v < 0 ? -0.5 : 0.5))) {}
+    static constexpr Fixed fromRaw(int32_t r) {
+        Fixed f{};
+        f.raw = r;
+        return f;
+    }
+    constexpr operator double() const { return raw / ONE; }
 
-// random number generation setup
-static std::random_device rd;
-static std::mt19937 gen(rd());
+    constexpr Fixed operator-() const { return fromRaw(-raw); }
+    constexpr Fixed &operator+=(Fixed o) {
+        raw += o.raw;
+        return *this;
+    }
+    constexpr Fixed &operator-=(Fixed o) {
+        raw -= o.raw;
+        return *this;
+    }
+    friend constexpr Fixed operator+(Fixed a, Fixed b) { return fromRaw(a.raw + b.raw); }
+    friend constexpr Fixed operator-(Fixed a, Fixed b) { return fromRaw(a.raw - b.raw); }
+    friend constexpr Fixed operator*(Fixed a, int k) { return fromRaw(a.raw * k); }
+    friend constexpr Fixed operator/(Fixed a, int k) { return fromRaw(a.raw / k); }
+    friend constexpr bool operator==(Fixed a, Fixed b) { return a.raw == b.raw; }
+    friend constexpr bool operator!=(Fixed a, Fixed b) { return a.raw != b.raw; }
+    friend constexpr bool operator<(Fixed a, Fixed b) { return a.raw < b.raw; }
+    friend constexpr bool operator<=(Fixed a, Fixed b) { return a.raw <= b.raw; }
+    friend constexpr bool operator>(Fixed a, Fixed b) { return a.raw > b.raw; }
+    friend constexpr bool operator>=(Fixed a, Fixed b) { return a.raw >= b.raw; }
+};
+using Coord = Fixed;
+
+// Nearest whole number of `unit`s in `d`, halves away from zero
+int roundedSteps(Fixed d, Fixed unit) {
+    int64_t half = unit.raw / 2;
+    return static_cast<int>((d.raw >= 0 ? d.raw + half : d.raw - half) / unit.raw);
+}
+#else
+using Coord = double;
+
+int roundedSteps(double d, double unit) { return static_cast<int>(std::lround(d / unit)); }
+#endif
+
+// random number generation setup: gameplay and scenery use separate streams of the same session seed so
+// purely visual scenery never perturbs traffic
+uint64_t sessionSeed = 0;
+static Pcg32 gen;
+static Pcg32 sceneryGen;
+
+void seedSession(uint64_t seed) {
+    sessionSeed = seed;
+    gen.seed(seed);
+    sceneryGen.seed(seed, 7);
+}
 
 // alias for random distributions
 using RandInt = std::uniform_int_distribution<>;
@@ -35,19 +162,43 @@ bool gameFinished = false; // Indicates if the game is finished
 // game settings
 bool isCollisionEnabled = true;
 
+// simulation clock: advances by TICK_MS per update() tick so that runs replay identically
+const int TICK_MS = 30;
+uint32_t simTick = 0;
+int simTimeMs() { return static_cast<int>(simTick) * TICK_MS; }
+
+// Set while ticks that already ran once are simulated again (rollback, replay seek). Effects outside the
+// simulation (telemetry, console messages, saved results) are skipped so they happen once.
+bool resimulating = false;
+
 // timing for start/finish lines
 int gameStartTimeMs = 0;
 const int START_LINE_SHOW_MS = 2000; // show start line for 2 seconds
 const int FINISH_LINE_AT_MS = 60000; // show finish line after 60 seconds
 
 // game variables
-double playerX = 0.0;
-double playerY = -0.75;
-
 double roadWidth = 0.9;
-double carWidth = 0.16;
-double carHeight = 0.2;
-double margin = (roadWidth - carWidth) / 2;
+constexpr double DEFAULT_CAR_WIDTH = 0.16;
+constexpr double DEFAULT_CAR_HEIGHT = 0.2;
+double carWidth = DEFAULT_CAR_WIDTH;
+double carHeight = DEFAULT_CAR_HEIGHT;
+Coord margin{(roadWidth - carWidth) / 2};
+
+// One car per player. Every instance simulates all of them; a crashed car drops out until the next reset.
+struct Player {
+    Coord x, y;
+    bool crashed;
+};
+std::array<Player, MAX_PLAYERS> players{};
+int playerCount = 1;
+const Coord PLAYER_START_Y{-0.75};
+
+// cars start spread evenly across the road; a single player starts in the middle
+void resetPlayers() {
+    for (int i = 0; i < playerCount; ++i) {
+        players[i] = {-margin + margin * 2 * (i + 1) / (playerCount + 1), PLAYER_START_Y, false};
+    }
+}
 
 enum class SceneryType {
     GRASS,
@@ -57,1222 +208,6329 @@ enum class SceneryType {
 static SceneryType currentScenery = SceneryType::DESERT;
 static int scenerayIntervalMS = 10000; // 20 seconds
 
-// #region Scenery
-
-// ----- Grass -----
-std::vector<std::pair<double, double>> leftGrassBlades;
-std::vector<std::pair<double, double>> rightGrassBlades;
+// #region Platform
+
+// Shared, growable file mapping used by the on-disk logs
+struct MappedFile {
+    uint8_t *data = nullptr;
+    size_t size = 0;
+    bool writable = false;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
 
-void initGrass() {
-    leftGrassBlades.clear();
-    rightGrassBlades.clear();
-    int numBlades = 200;
-    leftGrassBlades.reserve(numBlades);
-    rightGrassBlades.reserve(numBlades);
-    RandReal xDist(-1.0, -roadWidth / 2 - 0.05);
-    RandReal yDist(-1.0, 1.0);
-    for (int i = 0; i < numBlades; ++i) {
-        leftGrassBlades.emplace_back(xDist(gen), yDist(gen));
-        rightGrassBlades.emplace_back(-xDist(gen), yDist(gen));
-    }
+#ifdef _WIN32
+bool mapView(MappedFile &f) {
+    DWORD hi = static_cast<DWORD>(static_cast<uint64_t>(f.size) >> 32);
+    DWORD lo = static_cast<DWORD>(f.size & 0xFFFFFFFFu);
+    f.mapping = CreateFileMappingA(f.file, nullptr, f.writable ? PAGE_READWRITE : PAGE_READONLY, hi, lo, nullptr);
+    if (f.mapping == nullptr) return false;
+    DWORD access = f.writable ? FILE_MAP_WRITE : FILE_MAP_READ;
+    f.data = static_cast<uint8_t *>(MapViewOfFile(f.mapping, access, 0, 0, f.size));
+    return f.data != nullptr;
 }
 
-void drawGrass() {
-    glColor3ub(46, 111, 64);
-
-    glBegin(GL_QUADS);
-    glVertex2d(-1.0, -1.0);
-    glVertex2d(-roadWidth / 2, -1.0);
-    glVertex2d(-roadWidth / 2, 1.0);
-    glVertex2d(-1.0, 1.0);
-    glEnd();
+void unmapView(MappedFile &f) {
+    if (f.data != nullptr) UnmapViewOfFile(f.data);
+    if (f.mapping != nullptr) CloseHandle(f.mapping);
+    f.data = nullptr;
+    f.mapping = nullptr;
+}
 
-    glBegin(GL_QUADS);
-    glVertex2d(roadWidth / 2, -1.0);
-    glVertex2d(1.0, -1.0);
-    glVertex2d(1.0, 1.0);
-    glVertex2d(roadWidth / 2, 1.0);
-    glEnd();
+void closeMapped(MappedFile &f) {
+    unmapView(f);
+    if (f.file != INVALID_HANDLE_VALUE) CloseHandle(f.file);
+    f.file = INVALID_HANDLE_VALUE;
+    f.size = 0;
+}
 
-    glColor3ub(104, 186, 127);
-    for (const auto &blade : leftGrassBlades) {
-        glBegin(GL_LINES);
-        glVertex2d(blade.first, blade.second);
-        glVertex2d(blade.first + 0.01, blade.second + 0.03);
-        glEnd();
+// Map `path`, creating/extending it to at least `minSize` bytes when writable
+bool openMapped(MappedFile &f, const char *path, bool writable, size_t minSize = 0) {
+    f.writable = writable;
+    f.file = CreateFileA(path, GENERIC_READ | (writable ? GENERIC_WRITE : 0), FILE_SHARE_READ | FILE_SHARE_WRITE,
+                         nullptr, writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (f.file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(f.file, &fileSize);
+    f.size = std::max(static_cast<size_t>(fileSize.QuadPart), writable ? minSize : 0);
+    if (f.size == 0 || !mapView(f)) {
+        closeMapped(f);
+        return false;
     }
-    for (const auto &blade : rightGrassBlades) {
-        glBegin(GL_LINES);
-        glVertex2d(blade.first, blade.second);
-        glVertex2d(blade.first - 0.01, blade.second + 0.03);
-        glEnd();
+    return true;
+}
+
+// Grow the file and its mapping; on failure the old mapping stays in place
+bool resizeMapped(MappedFile &f, size_t newSize) {
+    MappedFile grown = f;
+    grown.size = newSize;
+    if (!mapView(grown)) {
+        unmapView(grown);
+        return false;
     }
+    unmapView(f);
+    f = grown;
+    return true;
+}
+#else
+void closeMapped(MappedFile &f) {
+    if (f.data != nullptr) munmap(f.data, f.size);
+    if (f.fd >= 0) ::close(f.fd);
+    f.data = nullptr;
+    f.fd = -1;
+    f.size = 0;
 }
 
-void updateGrass() {
-    for (auto &[x, y] : leftGrassBlades) {
-        y -= 0.01;
-        if (y < -1.0) y = 1.0;
+// Map `path`, creating/extending it to at least `minSize` bytes when writable
+bool openMapped(MappedFile &f, const char *path, bool writable, size_t minSize = 0) {
+    f.writable = writable;
+    f.fd = ::open(path, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (f.fd < 0) return false;
+    struct stat st {};
+    fstat(f.fd, &st);
+    f.size = static_cast<size_t>(st.st_size);
+    if (writable && f.size < minSize) {
+        if (ftruncate(f.fd, static_cast<off_t>(minSize)) != 0) {
+            closeMapped(f);
+            return false;
+        }
+        f.size = minSize;
     }
-    for (auto &[x, y] : rightGrassBlades) {
-        y -= 0.01;
-        if (y < -1.0) y = 1.0;
+    void *p = f.size > 0 ? mmap(nullptr, f.size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, f.fd, 0)
+                         : MAP_FAILED;
+    if (p == MAP_FAILED) {
+        closeMapped(f);
+        return false;
     }
+    f.data = static_cast<uint8_t *>(p);
+    return true;
 }
 
-// ----- Desert -----
-struct Cactus {
-    double x, y;
-    double size;
-};
-std::vector<Cactus> leftCt;
-std::vector<Cactus> rightCt;
-
-// ----- River -----
-struct WavePoint {
-    double x, y;
-    double amplitude;
-    double frequency;
-    double phase;
+// Grow the file and its mapping; on failure the old mapping stays in place
+bool resizeMapped(MappedFile &f, size_t newSize) {
+    if (ftruncate(f.fd, static_cast<off_t>(newSize)) != 0) return false;
+    void *p = mmap(nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, f.fd, 0);
+    if (p == MAP_FAILED) return false;
+    munmap(f.data, f.size);
+    f.data = static_cast<uint8_t *>(p);
+    f.size = newSize;
+    return true;
+}
+#endif
+
+// Non-blocking IPv4 sockets: UDP for netplay, TCP for spectators
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+const SocketHandle NO_SOCKET = INVALID_SOCKET;
+#else
+using SocketHandle = int;
+const SocketHandle NO_SOCKET = -1;
+#endif
+
+struct UdpSocket {
+    SocketHandle handle = NO_SOCKET;
 };
 
-std::vector<WavePoint> leftWaves;
-std::vector<WavePoint> rightWaves;
-double waveTime = 0.0;
-
-void initRiver() {
-    leftWaves.clear();
-    rightWaves.clear();
-    waveTime = 0.0;
+bool startSockets() {
+#ifdef _WIN32
+    static bool started = false;
+    WSADATA wsa;
+    if (!started && WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return false;
+    started = true;
+#endif
+    return true;
+}
 
-    // Initialize wave points for left side
-    int numWaves = 15;
-    leftWaves.reserve(numWaves);
-    RandReal xLeft(-1.0, -roadWidth / 2 - 0.05);
-    RandReal yDist(-1.0, 1.0);
-    RandReal ampDist(0.02, 0.05);
-    RandReal freqDist(1.0, 3.0);
-    RandReal phaseDist(0.0, 2.0 * PI);
+void closeSocket(SocketHandle &h) {
+    if (h == NO_SOCKET) return;
+#ifdef _WIN32
+    closesocket(h);
+#else
+    ::close(h);
+#endif
+    h = NO_SOCKET;
+}
 
-    for (int i = 0; i < numWaves; ++i) {
-        leftWaves.push_back({
-            xLeft(gen),
-            yDist(gen),
-            ampDist(gen),
-            freqDist(gen),
-            phaseDist(gen),
-        });
-    }
+void closeUdp(UdpSocket &s) { closeSocket(s.handle); }
 
-    // Initialize wave points for right side
-    RandReal xRight(roadWidth / 2 + 0.05, 1.0);
-    for (int i = 0; i < numWaves; ++i) {
-        rightWaves.push_back({
-            xRight(gen),
-            yDist(gen),
-            ampDist(gen),
-            freqDist(gen),
-            phaseDist(gen),
-        });
-    }
+bool setNonBlocking(SocketHandle h) {
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    return ioctlsocket(h, FIONBIO, &nonBlocking) == 0;
+#else
+    return fcntl(h, F_SETFL, fcntl(h, F_GETFL, 0) | O_NONBLOCK) == 0;
+#endif
 }
 
-void drawRiver() {
-    // Draw water background (deep blue)
-    glColor3ub(30, 144, 255);
+// The last socket call failed only because it would have blocked
+bool socketWouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
 
-    // Left water area
-    glBegin(GL_QUADS);
-    glVertex2d(-1.0, -1.0);
-    glVertex2d(-roadWidth / 2, -1.0);
-    glVertex2d(-roadWidth / 2, 1.0);
-    glVertex2d(-1.0, 1.0);
-    glEnd();
+sockaddr_in anyAddress(uint16_t port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    return addr;
+}
 
-    // Right water area
-    glBegin(GL_QUADS);
-    glVertex2d(roadWidth / 2, -1.0);
-    glVertex2d(1.0, -1.0);
-    glVertex2d(1.0, 1.0);
-    glVertex2d(roadWidth / 2, 1.0);
-    glEnd();
+// Bind to `port` on every interface
+bool openUdp(UdpSocket &s, uint16_t port) {
+    if (!startSockets()) return false;
+    s.handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s.handle == NO_SOCKET) return false;
 
-    // Draw animated waves
-    glColor3ub(135, 206, 250); // Light blue for waves
-    for (const auto &wave : leftWaves) {
-        double waveY = wave.y + wave.amplitude * sin(wave.frequency * waveTime + wave.phase);
-        glBegin(GL_LINES);
-        glVertex2d(wave.x - 0.05, waveY);
-        glVertex2d(wave.x + 0.05, waveY);
-        glEnd();
+    sockaddr_in addr = anyAddress(port);
+    if (!setNonBlocking(s.handle) || bind(s.handle, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) != 0) {
+        closeUdp(s);
+        return false;
     }
+    return true;
+}
 
-    for (const auto &wave : rightWaves) {
-        double waveY = wave.y + wave.amplitude * sin(wave.frequency * waveTime + wave.phase);
-        glBegin(GL_LINES);
-        glVertex2d(wave.x - 0.05, waveY);
-        glVertex2d(wave.x + 0.05, waveY);
-        glEnd();
+// Non-blocking TCP listener on `port` on every interface
+bool listenTcp(SocketHandle &s, uint16_t port) {
+    if (!startSockets()) return false;
+    s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == NO_SOCKET) return false;
+
+    int reuse = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+    sockaddr_in addr = anyAddress(port);
+    if (!setNonBlocking(s) || bind(s, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        listen(s, 8) != 0) {
+        closeSocket(s);
+        return false;
     }
+    return true;
 }
 
-void updateRiver() {
-    waveTime += 0.05; // Increment wave animation time
+// A pending connection as a non-blocking socket, or NO_SOCKET
+SocketHandle acceptTcp(SocketHandle listener) {
+    SocketHandle s = accept(listener, nullptr, nullptr);
+    if (s == NO_SOCKET) return s;
+#ifdef SO_NOSIGPIPE
+    int on = 1; // where send() has no MSG_NOSIGNAL
+    setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    if (!setNonBlocking(s)) closeSocket(s);
+    return s;
 }
 
-void drawCactus(double x, double y, double size) {
-    glColor3ub(34, 139, 34);
-
-    // Draw circular base of the cactus
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2d(x, y);               // Center point
-    for (int i = 0; i <= 12; ++i) { // 12 segments for smooth circle
-        double angle = 2.0 * PI * i / 12;
-        double dx = size * 0.3 * cos(angle);
-        double dy = size * 0.3 * sin(angle);
-        glVertex2d(x + dx, y + dy);
+// Blocking connect; the socket is made non-blocking once connected
+bool connectTcp(SocketHandle &s, const sockaddr_in &addr) {
+    if (!startSockets()) return false;
+    s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == NO_SOCKET) return false;
+    if (connect(s, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) != 0 || !setNonBlocking(s)) {
+        closeSocket(s);
+        return false;
     }
-    glEnd();
+    return true;
+}
 
-    // Draw spikes (starburst effect)
-    glBegin(GL_LINES);
-    for (int i = 0; i < 12; ++i) {
-        double angle = 2.0 * PI * i / 12;
-        double dx = size * 0.35 * cos(angle);
-        double dy = size * 0.35 * sin(angle);
-        glVertex2d(x, y);
-        glVertex2d(x + dx, y + dy);
-    }
-    glEnd();
+// Bytes written, 0 when the send buffer is full, -1 when the connection is gone
+int sendTcp(SocketHandle s, const void *data, size_t size) {
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL; // a closed peer must not raise SIGPIPE
+#else
+    const int flags = 0;
+#endif
+    int n = static_cast<int>(send(s, static_cast<const char *>(data), static_cast<int>(size), flags));
+    if (n >= 0) return n;
+    return socketWouldBlock() ? 0 : -1;
 }
 
-void initDesert() {
-    leftCt.clear();
-    rightCt.clear();
-    int num = 10;
-    leftCt.reserve(num);
-    rightCt.reserve(num);
-    RandReal xLeft(-1.0, -roadWidth / 2 - 0.05);
-    RandReal xRight(roadWidth / 2 + 0.05, 1.0);
-    RandReal yDist(-1.0, 1.0);
-    RandReal sDist(0.05, 0.2);
-    for (int i = 0; i < num; ++i) {
-        leftCt.push_back({xLeft(gen), yDist(gen), sDist(gen)});
-        rightCt.push_back({xRight(gen), yDist(gen), sDist(gen)});
-    }
+// Bytes read, 0 when nothing is waiting, -1 when the connection is closed
+int recvTcp(SocketHandle s, void *buf, size_t size) {
+    int n = static_cast<int>(recv(s, static_cast<char *>(buf), static_cast<int>(size), 0));
+    if (n > 0) return n;
+    return n < 0 && socketWouldBlock() ? 0 : -1;
 }
 
-void drawDesert() {
-    glColor3ub(237, 201, 175);
-    glBegin(GL_QUADS); // left sand
-    glVertex2d(-1.0, -1.0);
-    glVertex2d(-roadWidth / 2, -1.0);
-    glVertex2d(-roadWidth / 2, 1.0);
-    glVertex2d(-1.0, 1.0);
-    glEnd();
-    glBegin(GL_QUADS); // right sand
-    glVertex2d(roadWidth / 2, -1.0);
-    glVertex2d(1.0, -1.0);
-    glVertex2d(1.0, 1.0);
-    glVertex2d(roadWidth / 2, 1.0);
-    glEnd();
-    for (const auto &c : leftCt) {
-        drawCactus(c.x, c.y, c.size);
-    }
-    for (const auto &c : rightCt) {
-        drawCactus(c.x, c.y, c.size);
-    }
+// "host:port" with a dotted IPv4 host
+bool parseAddress(const char *text, sockaddr_in &addr) {
+    const char *colon = std::strrchr(text, ':');
+    if (colon == nullptr) return false;
+    std::string host(text, colon);
+    addr = sockaddr_in{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(std::strtoul(colon + 1, nullptr, 10)));
+    return inet_pton(AF_INET, host.c_str(), &addr.sin_addr) == 1;
 }
 
-void updateDesert() {
-    for (auto &c : leftCt) {
-        c.y -= 0.01;
-        if (c.y < -1.0) c.y = 1.0;
-    }
-    for (auto &c : rightCt) {
-        c.y -= 0.01;
-        if (c.y < -1.0) c.y = 1.0;
-    }
+void sendUdp(const UdpSocket &s, const sockaddr_in &to, const void *data, size_t size) {
+    sendto(s.handle, static_cast<const char *>(data), static_cast<int>(size), 0,
+           reinterpret_cast<const sockaddr *>(&to), sizeof(to));
 }
 
-// Scenery
-void initScenery(SceneryType t) {
-    switch (t) {
-    case SceneryType::GRASS:
-        initGrass();
-        break;
-    case SceneryType::DESERT:
-        initDesert();
-        break;
-    case SceneryType::RIVER:
-        initRiver();
-        break;
-    }
+// Size of the datagram read into `buf`, or -1 when nothing is waiting
+int recvUdp(const UdpSocket &s, void *buf, size_t size) {
+    return static_cast<int>(recvfrom(s.handle, static_cast<char *>(buf), static_cast<int>(size), 0, nullptr, nullptr));
 }
 
-void drawScenery() {
-    switch (currentScenery) {
-    case SceneryType::GRASS:
-        drawGrass();
-        break;
-    case SceneryType::DESERT:
-        drawDesert();
-        break;
-    case SceneryType::RIVER:
-        drawRiver();
-        break;
-    }
+// High-water mark of the process' resident memory
+size_t peakRssBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+    return pmc.PeakWorkingSetSize;
+#else
+    rusage ru{};
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>(ru.ru_maxrss); // bytes on macOS
+#else
+    return static_cast<size_t>(ru.ru_maxrss) * 1024; // kilobytes elsewhere
+#endif
+#endif
 }
 
-void updateScenery() {
-    switch (currentScenery) {
-    case SceneryType::GRASS:
-        updateGrass();
-        break;
-    case SceneryType::DESERT:
-        updateDesert();
-        break;
-    case SceneryType::RIVER:
-        updateRiver();
-        break;
-    }
+// #endregion Platform
+
+// #region Memory
+
+// Allocation counting (CARRACE_ALLOC_COUNT, implied by CARRACE_ALLOC_CHECK). Only the thread that runs the game
+// loop counts, so the telemetry drainer and other workers do not blur the per-frame numbers.
+thread_local uint64_t threadHeapAllocations = 0;
+
+#if defined(CARRACE_ALLOC_COUNT) || defined(CARRACE_ALLOC_CHECK)
+constexpr bool COUNTS_ALLOCATIONS = true;
+void *operator new(size_t size) {
+    ++threadHeapAllocations;
+    if (void *p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
 }
+void *operator new[](size_t size) { return operator new(size); }
+// not inlined, or GCC sees free() take a pointer from operator new and warns (-Wmismatched-new-delete)
+#ifdef _MSC_VER
+#define HEAP_NOINLINE __declspec(noinline)
+#else
+#define HEAP_NOINLINE __attribute__((noinline))
+#endif
+HEAP_NOINLINE void operator delete(void *p) noexcept { std::free(p); }
+HEAP_NOINLINE void operator delete[](void *p) noexcept { std::free(p); }
+HEAP_NOINLINE void operator delete(void *p, size_t) noexcept { std::free(p); }
+HEAP_NOINLINE void operator delete[](void *p, size_t) noexcept { std::free(p); }
+#else
+constexpr bool COUNTS_ALLOCATIONS = false;
+#endif
+
+// Guards one tick or frame. Once the game has warmed up (buffers at their high-water marks) a steady-state frame
+// must not touch the heap; with CARRACE_ALLOC_CHECK such a frame is reported and aborts.
+struct FrameAllocGuard {
+    static constexpr int WARMUP_FRAMES = 120;
+    static inline int frames = 0;
+    static inline uint64_t violations = 0;
+    static inline uint64_t lastFrameAllocations = 0;
+
+    const char *name;
+    uint64_t start = threadHeapAllocations;
+
+    explicit FrameAllocGuard(const char *name) : name(name) {}
+    FrameAllocGuard(const FrameAllocGuard &) = delete;
+    FrameAllocGuard &operator=(const FrameAllocGuard &) = delete;
+
+    ~FrameAllocGuard() {
+        lastFrameAllocations = threadHeapAllocations - start;
+        if (++frames <= WARMUP_FRAMES || lastFrameAllocations == 0) return;
+        ++violations;
+#ifdef CARRACE_ALLOC_CHECK
+        std::fprintf(stderr, "%s allocated %llu times in steady state\n", name,
+                     static_cast<unsigned long long>(lastFrameAllocations));
+        std::abort();
+#endif
+    }
+};
 
-int lastScenerySwitchTime = 0;
-void autoSwitchScenery() {
-    int now = glutGet(GLUT_ELAPSED_TIME);
-    if (now - lastScenerySwitchTime >= scenerayIntervalMS) {
-        lastScenerySwitchTime = now;
-        int next = (static_cast<int>(currentScenery) + 1) % 3;
-        currentScenery = static_cast<SceneryType>(next);
-        initScenery(currentScenery);
+// Bump allocator for data that only lives for one frame. reset() rewinds it; if a frame overflowed into the
+// heap, the next reset grows the main block to the high-water mark so later frames fit.
+struct FrameArena {
+    std::vector<uint8_t> block;
+    size_t used = 0;
+    size_t highWater = 0;
+    std::vector<std::unique_ptr<uint8_t[]>> overflow;
+
+    explicit FrameArena(size_t bytes) : block(bytes) {}
+
+    void *allocate(size_t bytes, size_t align) {
+        size_t offset = (used + align - 1) & ~(align - 1);
+        if (offset + bytes <= block.size()) {
+            used = offset + bytes;
+            highWater = std::max(highWater, used);
+            return block.data() + offset;
+        }
+        highWater = std::max(highWater, offset + bytes);
+        overflow.emplace_back(new uint8_t[bytes + align]);
+        auto addr = reinterpret_cast<uintptr_t>(overflow.back().get());
+        return reinterpret_cast<void *>((addr + align - 1) & ~(align - 1));
     }
-}
 
-// #endregion
+    void reset() {
+        if (!overflow.empty()) {
+            overflow.clear();
+            block.assign(highWater * 2, 0);
+        }
+        used = 0;
+    }
+};
+FrameArena frameArena(4 << 20);
 
-// #region Road
+// Growable array of trivially copyable items stored in the frame arena; growing abandons the old block until
+// the next reset, which is fine for per-frame data. Must be clear()ed each frame before use.
+template <typename T> struct ArenaArray {
+    static_assert(std::is_trivially_copyable<T>::value, "arena arrays hold plain data only");
 
-double laneOffset = 0.0;
-double roadScroll = 0.0;        // non-wrapping scroll accumulator for anchored features
-double startScroll0 = 0.0;      // roadScroll value at game start
-double finishScroll0 = 0.0;     // roadScroll value when finish line spawns
-bool finishLineSpawned = false; // indicates if finish line has been spawned
-std::vector<double> lanes;
-RandInt laneDist;
+    T *items = nullptr;
+    size_t count = 0;
+    size_t capacity = 0;
 
-void initRoad() {
-    int numLanes = static_cast<int>(roadWidth / carWidth);
-    lanes.reserve(numLanes);
-    double laneSpacing = roadWidth / numLanes;
-    double startX = -roadWidth / 2 + laneSpacing / 2;
-    for (int i = 0; i < numLanes; ++i) {
-        lanes.push_back(startX + i * laneSpacing);
+    void clear() {
+        items = nullptr;
+        count = 0;
+        capacity = 0;
     }
-    laneDist = RandInt(0, numLanes - 1);
-}
 
-void drawRoad() {
-    // road
-    glColor3d(0.2, 0.2, 0.2);
-    glBegin(GL_QUADS);
-    glVertex2d(-roadWidth / 2, -1.0);
-    glVertex2d(roadWidth / 2, -1.0);
-    glVertex2d(roadWidth / 2, 1.0);
-    glVertex2d(-roadWidth / 2, 1.0);
-    glEnd();
+    void reserve(size_t n) {
+        if (n <= capacity) return;
+        size_t newCapacity = std::max<size_t>({n, capacity * 2, 64});
+        T *grown = static_cast<T *>(frameArena.allocate(newCapacity * sizeof(T), alignof(T)));
+        if (count > 0) std::memcpy(grown, items, count * sizeof(T));
+        items = grown;
+        capacity = newCapacity;
+    }
 
-    // road borders
-    glColor3d(0.8, 0.8, 0.8);
+    void resize(size_t n) {
+        reserve(n);
+        count = n;
+    }
 
-    glBegin(GL_QUADS);
-    glVertex2d(-roadWidth / 2 - 0.02, -1.0);
-    glVertex2d(-roadWidth / 2, -1.0);
-    glVertex2d(-roadWidth / 2, 1.0);
-    glVertex2d(-roadWidth / 2 - 0.02, 1.0);
-    glEnd();
+    void push_back(const T &item) {
+        if (count == capacity) reserve(count + 1);
+        items[count++] = item;
+    }
 
-    glBegin(GL_QUADS);
-    glVertex2d(roadWidth / 2, -1.0);
-    glVertex2d(roadWidth / 2 + 0.02, -1.0);
-    glVertex2d(roadWidth / 2 + 0.02, 1.0);
-    glVertex2d(roadWidth / 2, 1.0);
-    glEnd();
+    void append(const T *first, size_t n) {
+        reserve(count + n);
+        std::memcpy(items + count, first, n * sizeof(T));
+        count += n;
+    }
 
-    for (double y = -1.4; y < 1.4; y += 0.1) {
-        glColor3d(1, 0.85, 0.2);
+    void swap(ArenaArray &other) {
+        std::swap(items, other.items);
+        std::swap(count, other.count);
+        std::swap(capacity, other.capacity);
+    }
 
-        glBegin(GL_QUADS);
-        glVertex2d(-roadWidth / 2 - 0.02, y + laneOffset);
-        glVertex2d(-roadWidth / 2, y + laneOffset);
-        glVertex2d(-roadWidth / 2, y + 0.05 + laneOffset);
-        glVertex2d(-roadWidth / 2 - 0.02, y + 0.05 + laneOffset);
-        glEnd();
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T *data() { return items; }
+    const T *data() const { return items; }
+    T *begin() { return items; }
+    T *end() { return items + count; }
+    const T *begin() const { return items; }
+    const T *end() const { return items + count; }
+    T &operator[](size_t i) { return items[i]; }
+    const T &operator[](size_t i) const { return items[i]; }
+};
 
-        glBegin(GL_QUADS);
-        glVertex2d(roadWidth / 2, y + laneOffset);
-        glVertex2d(roadWidth / 2 + 0.02, y + laneOffset);
-        glVertex2d(roadWidth / 2 + 0.02, y + 0.05 + laneOffset);
-        glVertex2d(roadWidth / 2, y + 0.05 + laneOffset);
-        glEnd();
-    }
+// Inline fixed-capacity vector for entity storage: never allocates, capacity is part of the type
+template <typename T, size_t N> struct FixedVector {
+    std::array<T, N> items;
+    size_t count = 0;
 
-    // lane markings
-    glColor3d(1, 1, 1);
-    for (double y = -1.4; y < 1.4; y += 0.2) {
-        glBegin(GL_QUADS);
-        glVertex2d(-0.01, y + laneOffset);
-        glVertex2d(0.01, y + laneOffset);
-        glVertex2d(0.01, y + 0.1 + laneOffset);
-        glVertex2d(-0.01, y + 0.1 + laneOffset);
-        glEnd();
+    FixedVector() = default;
+    // copies take only the live items, so a large capacity costs nothing while it is unused
+    FixedVector(const FixedVector &other) : count(other.count) {
+        std::copy(other.begin(), other.end(), items.begin());
+    }
+    FixedVector &operator=(const FixedVector &other) {
+        assign(other.begin(), other.end());
+        return *this;
     }
 
-    // start/finish lines
-    int now = glutGet(GLUT_ELAPSED_TIME);
-    int elapsed = now - gameStartTimeMs;
+    static constexpr size_t capacity() { return N; }
 
-    auto drawCheckeredLine = [&](double baseY, double height, double cellW) {
-        double left = -roadWidth / 2.0;
-        int cells = static_cast<int>(roadWidth / cellW) + 1;
-        for (int i = 0; i < cells; ++i) {
-            if (i % 2 == 0)
-                glColor3d(1, 1, 1);
-            else
-                glColor3d(0, 0, 0);
-            double x0 = left + i * cellW;
-            double x1 = x0 + cellW;
-            glBegin(GL_QUADS);
-            glVertex2d(x0, baseY);
-            glVertex2d(x1, baseY);
-            glVertex2d(x1, baseY + height);
-            glVertex2d(x0, baseY + height);
-            glEnd();
-        }
-    };
+    void clear() { count = 0; }
 
-    // Show start line only for a short time at game start
-    if (elapsed <= START_LINE_SHOW_MS) {
-        double startY = -0.6 + (roadScroll - startScroll0);
-        drawCheckeredLine(startY, 0.06, 0.06);
+    void pop_back() {
+        if (count > 0) --count;
     }
 
-    // Show finish line after a certain amount of time
-    if (elapsed >= FINISH_LINE_AT_MS) {
-        if (!finishLineSpawned) {
-            finishLineSpawned = true;
-            finishScroll0 = roadScroll; // remember spawn scroll position
+    void push_back(const T &item) {
+        if (count < N) items[count++] = item;
+    }
+
+    template <typename... Args> void emplace_back(Args &&...args) {
+        if (count < N) items[count++] = T{std::forward<Args>(args)...};
+    }
+
+    template <typename It> void assign(It first, It last) {
+        count = 0;
+        for (; first != last && count < N; ++first) {
+            items[count++] = *first;
         }
-        double finishY = 0.7 + (roadScroll - finishScroll0);
-        drawCheckeredLine(finishY, 0.06, 0.06);
     }
-}
 
-void updateRoad() {
-    laneOffset -= 0.02; // moves road lane markings down
-    if (laneOffset < -0.4) laneOffset = 0.0;
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T *data() { return items.data(); }
+    const T *data() const { return items.data(); }
+    T *begin() { return items.data(); }
+    T *end() { return items.data() + count; }
+    const T *begin() const { return items.data(); }
+    const T *end() const { return items.data() + count; }
+    T &operator[](size_t i) { return items[i]; }
+    const T &operator[](size_t i) const { return items[i]; }
+};
 
-    roadScroll -= 0.02; // non-wrapping scroll for anchored features
-}
+// #endregion Memory
 
-// #endregion Road
+// #region Trace
 
-// #region Car
+// Timeline profiling. TRACE_FUNCTION() opens a zone that closes at the end of the enclosing scope. Each thread
+// records its zones into a ring that only it writes, so a zone costs two clock reads and one slot store and never
+// locks. F4 writes the latest zones of every thread to trace.json as Chrome trace events, for chrome://tracing or
+// ui.perfetto.dev. Without CARRACE_TRACE the macros expand to nothing.
+const char *const TRACE_PATH = "trace.json";
 
-enum class CarType { SEDAN, SUV, TRACK };
+#ifdef CARRACE_TRACE
+struct TraceEvent {
+    const char *name; // static storage: string literals and __func__
+    int64_t startNs;
+    int64_t durationNs;
+};
 
-void drawRoundedRect(double x, double y, double w, double h, double radius, int segments = 12) {
-    double left = x - w * 0.5;
-    double right = x + w * 0.5;
-    double top = y + h * 0.75;
-    double bottom = y - h;
+// One thread's zones, oldest overwritten first
+struct TraceBuffer {
+    static constexpr size_t CAPACITY = 1 << 15;
+    std::array<TraceEvent, CAPACITY> events;
+    std::atomic<uint64_t> written{0};
+    char name[24] = "";
+};
 
-    // Corner centers
-    double cx[4] = {right - radius, left + radius, left + radius, right - radius};
-    double cy[4] = {top - radius, top - radius, bottom + radius, bottom + radius};
+struct Tracer {
+    static constexpr int MAX_THREADS = 64;
+    std::array<std::atomic<TraceBuffer *>, MAX_THREADS> buffers{};
+    std::atomic<int> threadCount{0};
+    const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    static inline thread_local TraceBuffer *local = nullptr;
+    static inline thread_local bool untraced = false; // came after MAX_THREADS
 
-    // Angles for each corner (in radians)
-    double start[4] = {0, PI / 2, PI, 3 * PI / 2};
+    ~Tracer() {
+        for (auto &b : buffers) delete b.load();
+    }
 
-    glBegin(GL_POLYGON);
+    int64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
 
-    for (int i = 0; i < 4; i++) {
-        for (int j = 0; j <= segments; j++) {
-            double theta = start[i] + (PI / 2) * (double)j / segments;
-            double vx = cx[i] + radius * cos(theta);
-            double vy = cy[i] + radius * sin(theta);
-            glVertex2d(vx, vy);
+    // The calling thread's ring, made on its first zone
+    TraceBuffer *buffer() {
+        if (local != nullptr || untraced) return local;
+        int slot = threadCount.fetch_add(1, std::memory_order_relaxed);
+        if (slot >= MAX_THREADS) {
+            untraced = true;
+            return nullptr;
         }
+        local = new TraceBuffer;
+        std::snprintf(local->name, sizeof(local->name), "thread %d", slot);
+        buffers[slot].store(local, std::memory_order_release);
+        return local;
     }
 
-    glEnd();
-}
+    void nameThread(const char *name) {
+        if (TraceBuffer *b = buffer()) std::snprintf(b->name, sizeof(b->name), "%s", name);
+    }
 
-void drawCar(double x, double y, double r, double g, double b, CarType type = CarType::SEDAN) {
-    double w = carWidth;
-    double h = carHeight;
+    void record(const char *name, int64_t startNs, int64_t endNs) {
+        TraceBuffer *b = buffer();
+        if (b == nullptr) return;
+        uint64_t n = b->written.load(std::memory_order_relaxed);
+        b->events[n % TraceBuffer::CAPACITY] = {name, startNs, endNs - startNs};
+        b->written.store(n + 1, std::memory_order_release);
+    }
 
-    switch (type) {
-    case CarType::SEDAN: {
-        glColor3d(r, g, b);
-        // Body
-        glBegin(GL_QUADS);
-        glVertex2d(x - w * 0.5, y - h);
-        glVertex2d(x + w * 0.5, y - h);
-        glVertex2d(x + w * 0.5, y + h * 0.75);
-        glVertex2d(x - w * 0.5, y + h * 0.75);
-        glEnd();
-
-        // Roof
-        glColor3d(r * 0.8, g * 0.8, b * 0.8);
-        glBegin(GL_QUADS);
-        glVertex2d(x - w * 0.4, y - h * 0.75);
-        glVertex2d(x + w * 0.4, y - h * 0.75);
-        glVertex2d(x + w * 0.4, y + h * 0.2);
-        glVertex2d(x - w * 0.4, y + h * 0.2);
-        glEnd();
-
-        // Windshield
-        glColor3d(0.5, 0.8, 1);
-        glBegin(GL_QUADS);
-        glVertex2d(x - w * 0.4, y + h * 0.15);
-        glVertex2d(x + w * 0.4, y + h * 0.15);
-        glVertex2d(x + w * 0.35, y + h * 0.5);
-        glVertex2d(x - w * 0.35, y + h * 0.5);
-        glEnd();
-
-        // Headlights
-        glColor3d(1, 1, 0);
-        glBegin(GL_QUADS); // left front
-        glVertex2d(x - w * 0.2, y + h * 0.80);
-        glVertex2d(x - w * 0.5, y + h * 0.80);
-        glVertex2d(x - w * 0.5, y + h * 0.75);
-        glVertex2d(x - w * 0.2, y + h * 0.75);
-        glEnd();
-        glBegin(GL_QUADS); // right front
-        glVertex2d(x + w * 0.2, y + h * 0.80);
-        glVertex2d(x + w * 0.5, y + h * 0.80);
-        glVertex2d(x + w * 0.5, y + h * 0.75);
-        glVertex2d(x + w * 0.2, y + h * 0.75);
-        glEnd();
-
-        glColor3d(1, 0, 0);
-        glBegin(GL_QUADS); // left rear
-        glVertex2d(x - w * 0.2, y - h * 1.05);
-        glVertex2d(x - w * 0.5, y - h * 1.05);
-        glVertex2d(x - w * 0.5, y - h);
-        glVertex2d(x - w * 0.2, y - h);
-        glEnd();
-        glBegin(GL_QUADS); // right rear
-        glVertex2d(x + w * 0.2, y - h * 1.05);
-        glVertex2d(x + w * 0.5, y - h * 1.05);
-        glVertex2d(x + w * 0.5, y - h);
-        glVertex2d(x + w * 0.2, y - h);
-        glEnd();
-
-        // Wheels
-        glColor3d(0.1, 0.1, 0.1);
-        glBegin(GL_QUADS); // left front
-        glVertex2d(x - w * 0.5, y + h * 0.6);
-        glVertex2d(x - w * 0.5, y + h * 0.2);
-        glVertex2d(x - w * 0.55, y + h * 0.2);
-        glVertex2d(x - w * 0.55, y + h * 0.6);
-        glEnd();
-        glBegin(GL_QUADS); // right front
-        glVertex2d(x + w * 0.5, y + h * 0.6);
-        glVertex2d(x + w * 0.5, y + h * 0.2);
-        glVertex2d(x + w * 0.55, y + h * 0.2);
-        glVertex2d(x + w * 0.55, y + h * 0.6);
-        glEnd();
-        glBegin(GL_QUADS); // left rear
-        glVertex2d(x - w * 0.5, y - h * 0.9);
-        glVertex2d(x - w * 0.5, y - h * 0.5);
-        glVertex2d(x - w * 0.55, y - h * 0.5);
-        glVertex2d(x - w * 0.55, y - h * 0.9);
-        glEnd();
-        glBegin(GL_QUADS); // right rear
-        glVertex2d(x + w * 0.5, y - h * 0.9);
-        glVertex2d(x + w * 0.5, y - h * 0.5);
-        glVertex2d(x + w * 0.55, y - h * 0.5);
-        glVertex2d(x + w * 0.55, y - h * 0.9);
-        glEnd();
-        break;
+    // Threads keep recording while this runs: events their writer may have lapped during the copy are dropped
+    bool write(const char *path) const {
+        std::FILE *f = std::fopen(path, "w");
+        if (f == nullptr) return false;
+        std::fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        std::vector<TraceEvent> copy(TraceBuffer::CAPACITY);
+        bool first = true;
+        int threads = std::min(threadCount.load(std::memory_order_relaxed), MAX_THREADS);
+        for (int t = 0; t < threads; ++t) {
+            const TraceBuffer *b = buffers[t].load(std::memory_order_acquire);
+            if (b == nullptr) continue;
+            uint64_t end = b->written.load(std::memory_order_acquire);
+            uint64_t begin = end > TraceBuffer::CAPACITY ? end - TraceBuffer::CAPACITY : 0;
+            for (uint64_t i = begin; i < end; ++i) copy[i - begin] = b->events[i % TraceBuffer::CAPACITY];
+            uint64_t after = b->written.load(std::memory_order_acquire);
+            uint64_t valid = after > TraceBuffer::CAPACITY ? std::max(begin, after - TraceBuffer::CAPACITY) : begin;
+
+            std::fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,",
+                         first ? "" : ",\n", t);
+            std::fprintf(f, "\"args\":{\"name\":\"%s\"}}", b->name);
+            first = false;
+            for (uint64_t i = valid; i < end; ++i) {
+                const TraceEvent &e = copy[i - begin];
+                std::fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                             e.name, t, e.startNs / 1000.0, e.durationNs / 1000.0);
+            }
+        }
+        std::fprintf(f, "\n]}\n");
+        return std::fclose(f) == 0;
     }
+};
+Tracer tracer;
 
-    case CarType::SUV: {
-        glColor3d(r, g, b);
-        // Body
-        drawRoundedRect(x, y, w, h * 1.1, w * 0.1);
-
-        // Roof
-        glColor3d(r * 0.8, g * 0.8, b * 0.8);
-        glBegin(GL_QUADS);
-        glVertex2d(x - w * 0.45, y - h * 0.75);
-        glVertex2d(x + w * 0.45, y - h * 0.75);
-        glVertex2d(x + w * 0.45, y + h * 0.3);
-        glVertex2d(x - w * 0.45, y + h * 0.3);
-        glEnd();
-
-        // Windshield
-        glColor3d(0.5, 0.8, 1);
-        glBegin(GL_QUADS);
-        glVertex2d(x - w * 0.45, y + h * 0.25);
-        glVertex2d(x + w * 0.45, y + h * 0.25);
-        glVertex2d(x + w * 0.4, y + h * 0.5);
-        glVertex2d(x - w * 0.4, y + h * 0.5);
-        glEnd();
-
-        // Headlights
-        glColor3d(1, 1, 0);
-        glBegin(GL_QUADS); // left front
-        glVertex2d(x - w * 0.3, y + h * 0.80);
-        glVertex2d(x - w * 0.5, y + h * 0.80);
-        glVertex2d(x - w * 0.5, y + h * 0.7);
-        glVertex2d(x - w * 0.3, y + h * 0.7);
-        glEnd();
-        glBegin(GL_QUADS); // right front
-        glVertex2d(x + w * 0.3, y + h * 0.80);
-        glVertex2d(x + w * 0.5, y + h * 0.80);
-        glVertex2d(x + w * 0.5, y + h * 0.7);
-        glVertex2d(x + w * 0.3, y + h * 0.7);
-        glEnd();
-
-        glColor3d(1, 0, 0);
-        glBegin(GL_QUADS); // left rear
-        glVertex2d(x - w * 0.3, y - h * 1.1);
-        glVertex2d(x - w * 0.5, y - h * 1.1);
-        glVertex2d(x - w * 0.5, y - h);
-        glVertex2d(x - w * 0.3, y - h);
-        glEnd();
-        glBegin(GL_QUADS); // right rear
-        glVertex2d(x + w * 0.3, y - h * 1.1);
-        glVertex2d(x + w * 0.5, y - h * 1.1);
-        glVertex2d(x + w * 0.5, y - h);
-        glVertex2d(x + w * 0.3, y - h);
-        glEnd();
-
-        // Wheels
-        glColor3d(0.1, 0.1, 0.1);
-        glBegin(GL_QUADS); // left front
-        glVertex2d(x - w * 0.5, y + h * 0.6);
-        glVertex2d(x - w * 0.5, y + h * 0.2);
-        glVertex2d(x - w * 0.55, y + h * 0.2);
-        glVertex2d(x - w * 0.55, y + h * 0.6);
-        glEnd();
-        glBegin(GL_QUADS); // right front
-        glVertex2d(x + w * 0.5, y + h * 0.6);
-        glVertex2d(x + w * 0.5, y + h * 0.2);
-        glVertex2d(x + w * 0.55, y + h * 0.2);
-        glVertex2d(x + w * 0.55, y + h * 0.6);
-        glEnd();
-        glBegin(GL_QUADS); // left rear
-        glVertex2d(x - w * 0.5, y - h * 0.9);
-        glVertex2d(x - w * 0.5, y - h * 0.5);
-        glVertex2d(x - w * 0.55, y - h * 0.5);
-        glVertex2d(x - w * 0.55, y - h * 0.9);
-        glEnd();
-        glBegin(GL_QUADS); // right rear
-        glVertex2d(x + w * 0.5, y - h * 0.9);
-        glVertex2d(x + w * 0.5, y - h * 0.5);
-        glVertex2d(x + w * 0.55, y - h * 0.5);
-        glVertex2d(x + w * 0.55, y - h * 0.9);
-        glEnd();
-        break;
+struct TraceZone {
+    const char *name;
+    int64_t startNs = tracer.now();
+
+    explicit TraceZone(const char *name) : name(name) {}
+    TraceZone(const TraceZone &) = delete;
+    TraceZone &operator=(const TraceZone &) = delete;
+    ~TraceZone() { tracer.record(name, startNs, tracer.now()); }
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_FUNCTION() TRACE_ZONE(__func__)
+#define TRACE_THREAD(name) tracer.nameThread(name)
+
+bool writeTrace(const char *path) { return tracer.write(path); }
+#else
+#define TRACE_ZONE(name) static_cast<void>(0)
+#define TRACE_FUNCTION() static_cast<void>(0)
+#define TRACE_THREAD(name) static_cast<void>(0)
+
+bool writeTrace(const char *) { return false; }
+#endif
+
+// #endregion Trace
+
+// #region Entities
+
+// Generational entity handle. The slot stays put while rows move around; its generation changes when the entity
+// is destroyed, so a handle kept past that point stops resolving instead of aliasing whatever reuses the slot.
+struct Entity {
+    uint32_t slot = UINT32_MAX;
+    uint32_t generation = 0;
+};
+
+// One component column. The table inherits one per component type instead of holding a std::tuple, whose default
+// constructor would zero every row on each copy of the table.
+template <typename C, size_t N> struct Column {
+    std::array<C, N> rows;
+    Column() {} // leaves the rows uninitialized, even when value-initialized
+};
+
+// Archetype table: every entity in it has the same components, stored structure-of-arrays with one dense column
+// per component type; row i of each column belongs to the same entity. Rows stay packed (destroying moves the last
+// row into the hole), so systems are linear scans over plain arrays. Capacity is fixed, nothing allocates, and
+// copies take only the live rows and issued slots, like FixedVector.
+template <size_t N, typename... Components> struct ArchetypeTable : Column<Components, N>... {
+    std::array<uint32_t, N> rowSlot;        // slot of each row
+    std::array<uint32_t, N> slotRow;        // row of each issued slot
+    std::array<uint32_t, N> slotGeneration; // generation of each issued slot
+    std::array<uint32_t, N> freeSlots;      // destroyed slots, reused last-in first-out
+    uint32_t count = 0;
+    uint32_t issuedSlots = 0;
+    uint32_t freeCount = 0;
+
+    ArchetypeTable() = default;
+    ArchetypeTable(const ArchetypeTable &other) : Column<Components, N>()... { *this = other; }
+    ArchetypeTable &operator=(const ArchetypeTable &other) {
+        count = other.count;
+        issuedSlots = other.issuedSlots;
+        freeCount = other.freeCount;
+        (std::copy_n(other.template column<Components>(), count, column<Components>()), ...);
+        std::copy_n(other.rowSlot.begin(), count, rowSlot.begin());
+        std::copy_n(other.slotRow.begin(), issuedSlots, slotRow.begin());
+        std::copy_n(other.slotGeneration.begin(), issuedSlots, slotGeneration.begin());
+        std::copy_n(other.freeSlots.begin(), freeCount, freeSlots.begin());
+        return *this;
     }
 
-    case CarType::TRACK: {
-        glColor3d(r, g, b);
-        // Body
-        glBegin(GL_QUADS);
-        glVertex2d(x - w * 0.5, y - h);
-        glVertex2d(x + w * 0.5, y - h);
-        glVertex2d(x + w * 0.5, y + h * 0.75);
-        glVertex2d(x - w * 0.5, y + h * 0.75);
-        glEnd();
-
-        // Roof
-        glColor3d(r * 0.8, g * 0.8, b * 0.8);
-        glBegin(GL_QUADS);
-        glVertex2d(x - w * 0.4, y - h * 0.75);
-        glVertex2d(x + w * 0.4, y - h * 0.75);
-        glVertex2d(x + w * 0.4, y + h * 0.35);
-        glVertex2d(x - w * 0.4, y + h * 0.35);
-        glEnd();
-
-        // Trunk
-        glColor3d(r * 0.2, g * 0.6, b * 0.9);
-        glBegin(GL_QUADS);
-        glVertex2d(x - w * 0.45, y - h * 0.9);
-        glVertex2d(x + w * 0.45, y - h * 0.9);
-        glVertex2d(x + w * 0.45, y - h * 0.05);
-        glVertex2d(x - w * 0.45, y - h * 0.05);
-        glEnd();
-
-        // Windshield
-        glColor3d(0.5, 0.8, 1);
-        glBegin(GL_QUADS);
-        glVertex2d(x - w * 0.4, y + h * 0.35);
-        glVertex2d(x + w * 0.4, y + h * 0.35);
-        glVertex2d(x + w * 0.35, y + h * 0.6);
-        glVertex2d(x - w * 0.35, y + h * 0.6);
-        glEnd();
-
-        // Headlights (front) and taillights (rear)
-        glColor3d(1, 1, 0);
-        glBegin(GL_QUADS); // left front
-        glVertex2d(x - w * 0.2, y + h * 0.80);
-        glVertex2d(x - w * 0.5, y + h * 0.80);
-        glVertex2d(x - w * 0.5, y + h * 0.75);
-        glVertex2d(x - w * 0.2, y + h * 0.75);
-        glEnd();
-        glBegin(GL_QUADS); // right front
-        glVertex2d(x + w * 0.2, y + h * 0.80);
-        glVertex2d(x + w * 0.5, y + h * 0.80);
-        glVertex2d(x + w * 0.5, y + h * 0.75);
-        glVertex2d(x + w * 0.2, y + h * 0.75);
-        glEnd();
-
-        glColor3d(1, 0, 0);
-        glBegin(GL_QUADS); // left rear
-        glVertex2d(x - w * 0.2, y - h * 1.05);
-        glVertex2d(x - w * 0.5, y - h * 1.05);
-        glVertex2d(x - w * 0.5, y - h);
-        glVertex2d(x - w * 0.2, y - h);
-        glEnd();
-        glBegin(GL_QUADS); // right rear
-        glVertex2d(x + w * 0.2, y - h * 1.05);
-        glVertex2d(x + w * 0.5, y - h * 1.05);
-        glVertex2d(x + w * 0.5, y - h);
-        glVertex2d(x + w * 0.2, y - h);
-        glEnd();
-
-        // Wheels
-        glColor3d(0.1, 0.1, 0.1);
-        glBegin(GL_QUADS); // left front
-        glVertex2d(x - w * 0.5, y + h * 0.6);
-        glVertex2d(x - w * 0.5, y + h * 0.2);
-        glVertex2d(x - w * 0.55, y + h * 0.2);
-        glVertex2d(x - w * 0.55, y + h * 0.6);
-        glEnd();
-        glBegin(GL_QUADS); // right front
-        glVertex2d(x + w * 0.5, y + h * 0.6);
-        glVertex2d(x + w * 0.5, y + h * 0.2);
-        glVertex2d(x + w * 0.55, y + h * 0.2);
-        glVertex2d(x + w * 0.55, y + h * 0.6);
-        glEnd();
-        glBegin(GL_QUADS); // left rear
-        glVertex2d(x - w * 0.5, y - h * 0.9);
-        glVertex2d(x - w * 0.5, y - h * 0.5);
-        glVertex2d(x - w * 0.55, y - h * 0.5);
-        glVertex2d(x - w * 0.55, y - h * 0.9);
-        glEnd();
-        glBegin(GL_QUADS); // right rear
-        glVertex2d(x + w * 0.5, y - h * 0.9);
-        glVertex2d(x + w * 0.5, y - h * 0.5);
-        glVertex2d(x + w * 0.55, y - h * 0.5);
-        glVertex2d(x + w * 0.55, y - h * 0.9);
-        glEnd();
-        break;
+    static constexpr size_t capacity() { return N; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    template <typename C> C *column() { return Column<C, N>::rows.data(); }
+    template <typename C> const C *column() const { return Column<C, N>::rows.data(); }
+
+    // Append an entity as the last row; returns an invalid handle when the table is full
+    Entity create(const Components &...values) {
+        if (count == N) return {};
+        uint32_t slot;
+        if (freeCount > 0) {
+            slot = freeSlots[--freeCount];
+        } else {
+            slot = issuedSlots++;
+            slotGeneration[slot] = 0;
+        }
+        uint32_t row = count++;
+        ((column<Components>()[row] = values), ...);
+        rowSlot[row] = slot;
+        slotRow[slot] = row;
+        return {slot, slotGeneration[slot]};
+    }
+
+    bool alive(Entity e) const { return e.slot < issuedSlots && slotGeneration[e.slot] == e.generation; }
+
+    // Current row of a live entity; rows change when other entities are destroyed
+    uint32_t row(Entity e) const { return slotRow[e.slot]; }
+    Entity handle(uint32_t row) const { return {rowSlot[row], slotGeneration[rowSlot[row]]}; }
+
+    void destroy(Entity e) {
+        if (alive(e)) destroyRow(slotRow[e.slot]);
+    }
+
+    // Remove a row by moving the last one into it. Loops that destroy as they go walk the rows backwards.
+    void destroyRow(uint32_t row) {
+        uint32_t slot = rowSlot[row];
+        ++slotGeneration[slot];
+        freeSlots[freeCount++] = slot;
+        uint32_t last = --count;
+        if (row == last) return;
+        ((column<Components>()[row] = column<Components>()[last]), ...);
+        rowSlot[row] = rowSlot[last];
+        slotRow[rowSlot[row]] = row;
     }
+
+    void clear() {
+        while (count > 0) destroyRow(count - 1);
     }
+};
+
+// Components shared by several archetypes
+struct Position {
+    Coord x, y;
+};
+struct Velocity {
+    double vx, vy;
+};
+struct Tint {
+    double r, g, b;
+};
+
+// #endregion Entities
+
+// #region Timers
+
+// Index of the lowest set bit; v must not be 0
+int lowestSetBit(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, v);
+    return static_cast<int>(i);
+#else
+    return __builtin_ctzll(v);
+#endif
 }
 
-// #endregion Car
+// Opaque reference to a scheduled timer; goes stale once the timer fires or is cancelled
+struct TimerHandle {
+    uint8_t node = UINT8_MAX;
+    uint8_t reserved = 0;
+    uint16_t generation = 0;
+};
 
-// #region Bridge
+// Hierarchical timer wheel on the simulation clock. Level k has 64 buckets spanning 64^k ticks each; a timer sits
+// in the lowest level whose range covers its delay and drops a level whenever the wheel reaches its bucket, so
+// scheduling, cancelling and advancing a tick cost the same however many timers are pending. Timers due on the same
+// tick fire in the order they were scheduled. Nodes are a fixed pool linked by index and the lowest free node is
+// always taken, so the wheel is trivially copyable and two wheels with the same history are byte-identical, which
+// lets snapshots store it as-is.
+struct TimerWheel {
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 6;
+    static constexpr uint32_t SLOTS = 1 << SLOT_BITS;
+    static constexpr uint32_t MAX_DELAY = (1u << (LEVELS * SLOT_BITS)) - 1; // ~5 days of ticks
+    static constexpr int MAX_TIMERS = 64; // one bit each in `used`
+    static constexpr uint8_t NONE = UINT8_MAX;
+
+    struct Node {
+        uint32_t due;
+        uint32_t seq; // scheduling order
+        uint16_t generation;
+        uint16_t arg;
+        uint16_t bucket; // level * SLOTS + slot
+        uint8_t type;
+        uint8_t prev, next; // bucket list
+        uint8_t reserved[3];
+    };
 
-struct Bridge {
-    double y;            // Y position of the bridge
-    double height;       // Height of the bridge structure
-    double shadowOffset; // Offset for shadow effect
-    bool active;         // Whether bridge is active/visible
+    std::array<Node, MAX_TIMERS> nodes{};
+    std::array<uint8_t, LEVELS * SLOTS> heads{};
+    uint64_t used = 0; // bit per node
+    uint32_t now = 0;  // last tick advanced to
+    uint32_t nextSeq = 0;
+
+    TimerWheel() { heads.fill(NONE); }
+
+    // Drop every timer and restart the clock at tick; outstanding handles go stale
+    void reset(uint32_t tick) {
+        for (int i = 0; i < MAX_TIMERS; ++i) {
+            if (used >> i & 1) ++nodes[i].generation;
+        }
+        heads.fill(NONE);
+        used = 0;
+        now = tick;
+        nextSeq = 0;
+    }
+
+    // Fire (type, arg) delay ticks from now; delays are clamped to 1..MAX_DELAY. Invalid handle when full.
+    TimerHandle schedule(uint32_t delay, uint8_t type, uint16_t arg = 0) {
+        if (~used == 0) return {};
+        int i = lowestSetBit(~used); // lowest free node
+        Node &n = nodes[i];
+        n.due = now + std::clamp(delay, uint32_t{1}, MAX_DELAY);
+        n.seq = nextSeq++;
+        n.type = type;
+        n.arg = arg;
+        used |= uint64_t{1} << i;
+        link(static_cast<uint8_t>(i));
+        return {static_cast<uint8_t>(i), 0, n.generation};
+    }
+
+    bool pending(TimerHandle h) const {
+        return h.node < MAX_TIMERS && (used >> h.node & 1) && nodes[h.node].generation == h.generation;
+    }
+
+    // Tick a pending timer fires on
+    uint32_t dueTick(TimerHandle h) const { return nodes[h.node].due; }
+
+    void cancel(TimerHandle h) {
+        if (!pending(h)) return;
+        unlink(h.node);
+        release(h.node);
+    }
+
+    // Step the clock up to tick, calling fire(type, arg) for every timer that comes due on the way. Callbacks may
+    // schedule and cancel timers; those land on later ticks.
+    template <typename Fn> void advance(uint32_t tick, Fn &&fire) {
+        while (now != tick) {
+            ++now;
+            // move timers down from every level whose bucket boundary was just reached, highest first so each
+            // lands in a bucket that has not been emptied yet
+            int top = 0;
+            while (top + 1 < LEVELS && (now & ((1u << (SLOT_BITS * (top + 1))) - 1)) == 0) ++top;
+            for (int level = top; level >= 1; --level) {
+                uint8_t i = detach(level, (now >> (SLOT_BITS * level)) & (SLOTS - 1));
+                while (i != NONE) {
+                    uint8_t next = nodes[i].next;
+                    link(i);
+                    i = next;
+                }
+            }
+
+            std::array<uint8_t, MAX_TIMERS> due;
+            int count = 0;
+            for (uint8_t i = detach(0, now & (SLOTS - 1)); i != NONE; i = nodes[i].next) {
+                due[count++] = i;
+            }
+            auto bySeq = [this](uint8_t a, uint8_t b) { return nodes[a].seq < nodes[b].seq; };
+            std::sort(due.begin(), due.begin() + count, bySeq);
+            for (int k = 0; k < count; ++k) {
+                const Node &n = nodes[due[k]];
+                uint8_t type = n.type;
+                uint16_t arg = n.arg;
+                release(due[k]);
+                fire(type, arg);
+            }
+        }
+    }
+
+  private:
+    void link(uint8_t i) {
+        Node &n = nodes[i];
+        uint32_t delta = n.due - now;
+        int level = 0;
+        while (level + 1 < LEVELS && delta >= (1u << (SLOT_BITS * (level + 1)))) ++level;
+        n.bucket = static_cast<uint16_t>(level * SLOTS + ((n.due >> (SLOT_BITS * level)) & (SLOTS - 1)));
+        n.prev = NONE;
+        n.next = heads[n.bucket];
+        if (n.next != NONE) nodes[n.next].prev = i;
+        heads[n.bucket] = i;
+    }
+
+    void unlink(uint8_t i) {
+        Node &n = nodes[i];
+        if (n.prev != NONE) {
+            nodes[n.prev].next = n.next;
+        } else {
+            heads[n.bucket] = n.next;
+        }
+        if (n.next != NONE) nodes[n.next].prev = n.prev;
+    }
+
+    // Take a whole bucket's list, leaving the bucket empty
+    uint8_t detach(int level, uint32_t slot) {
+        uint8_t &head = heads[level * SLOTS + slot];
+        uint8_t first = head;
+        head = NONE;
+        return first;
+    }
+
+    void release(uint8_t i) {
+        ++nodes[i].generation;
+        used &= ~(uint64_t{1} << i);
+    }
 };
+static_assert(std::has_unique_object_representations_v<TimerWheel>, "snapshots compare wheels byte-wise");
+
+// #endregion Timers
+
+// #region Workers
+
+// Work-stealing job system. Every thread has its own queue: it pushes and pops at the back, idle threads steal from
+// the front of the others. The thread that drives the game owns queue 0 and helps run jobs while it waits, so
+// nested waits inside jobs are fine. Jobs are plain function pointers with a context, so nothing is allocated.
+struct JobSystem {
+    using JobFn = void (*)(void *context, uint32_t index);
+    struct Job {
+        JobFn fn;
+        void *context;
+        uint32_t index;
+        std::atomic<uint32_t> *pending; // decremented once the job has run
+    };
 
-Bridge bridge;
-const double BRIDGE_HEIGHT = 0.6;
-const double BRIDGE_WIDTH = 2.0; // Spans full window width (left to right)
-int lastBridgeSpawnTime = 0;
-const int BRIDGE_SPAWN_INTERVAL_MS = 8000; // Spawn every 8 seconds
+    static constexpr size_t QUEUE_CAPACITY = 1024;
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::array<Job, QUEUE_CAPACITY> jobs;
+        size_t head = 0; // thieves take from here
+        size_t tail = 0; // the owner pushes and pops here
+    };
 
-void initBridge() {
-    // Initialize single bridge as inactive
-    bridge = {2.0, BRIDGE_HEIGHT, 0.02, false};
-    lastBridgeSpawnTime = glutGet(GLUT_ELAPSED_TIME);
+    std::vector<std::thread> threads;
+    std::unique_ptr<Queue[]> queues{new Queue[1]};
+    std::atomic<int> queued{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    static inline thread_local int self = 0; // queue of the calling thread
+
+    ~JobSystem() { stop(); }
+
+    // Threads that run jobs, including the caller
+    int size() const { return static_cast<int>(threads.size()) + 1; }
+
+    void start(int workers) {
+        queues.reset(new Queue[workers + 1]);
+        for (int i = 0; i < workers; ++i) {
+            threads.emplace_back([this, i] {
+                TRACE_THREAD("worker");
+                self = i + 1;
+                workerLoop();
+            });
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &t : threads) t.join();
+        threads.clear();
+    }
+
+    // Queue a job on the calling thread's queue; runs it right away if that queue is full
+    void submit(const Job &job) {
+        Queue &q = queues[self];
+        bool full;
+        {
+            std::lock_guard<std::mutex> lock(q.mutex);
+            full = q.tail - q.head == QUEUE_CAPACITY;
+            if (!full) q.jobs[q.tail++ % QUEUE_CAPACITY] = job;
+        }
+        if (full) {
+            job.fn(job.context, job.index);
+            job.pending->fetch_sub(1, std::memory_order_release);
+            return;
+        }
+        queued.fetch_add(1, std::memory_order_release);
+        {
+            // sleepers check `queued` under this lock, so the notify cannot slip in before they wait
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+    }
+
+    // Run one queued job, own queue first; false if there was nothing to do
+    bool tryRun() {
+        Job job;
+        if (!take(job)) return false;
+        job.fn(job.context, job.index);
+        job.pending->fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    // Help out until `pending` reaches zero
+    void wait(const std::atomic<uint32_t> &pending) {
+        while (pending.load(std::memory_order_acquire) > 0) {
+            if (!tryRun()) std::this_thread::yield();
+        }
+    }
+
+    // fn(begin, end) over [0, count) in chunks of `grain`; the caller takes the first chunk
+    template <typename Fn> void parallelFor(uint32_t count, uint32_t grain, Fn &&fn) {
+        uint32_t chunks = (count + grain - 1) / grain;
+        if (chunks <= 1 || threads.empty()) {
+            if (count > 0) fn(0u, count);
+            return;
+        }
+        ForRange<Fn> range{&fn, count, grain};
+        std::atomic<uint32_t> pending{chunks - 1};
+        for (uint32_t c = 1; c < chunks; ++c) {
+            submit({&ForRange<Fn>::run, &range, c, &pending});
+        }
+        fn(0u, grain);
+        wait(pending);
+    }
+
+  private:
+    template <typename Fn> struct ForRange {
+        Fn *fn;
+        uint32_t count, grain;
+
+        static void run(void *context, uint32_t chunk) {
+            auto &r = *static_cast<ForRange *>(context);
+            (*r.fn)(chunk * r.grain, std::min(r.count, (chunk + 1) * r.grain));
+        }
+    };
+
+    bool take(Job &job) {
+        int n = size();
+        for (int k = 0; k < n; ++k) {
+            int victim = (self + k) % n;
+            Queue &q = queues[victim];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.head == q.tail) continue;
+            job = victim == self ? q.jobs[--q.tail % QUEUE_CAPACITY] : q.jobs[q.head++ % QUEUE_CAPACITY];
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void workerLoop() {
+        for (;;) {
+            if (tryRun()) continue;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+            if (stopping) return;
+        }
+    }
+};
+JobSystem jobs;
+
+// Bits naming the pieces of state a task touches
+using ResourceMask = uint32_t;
+
+// Fixed graph of tasks with declared reads and writes. A task waits for every earlier task it conflicts with
+// (either one writes what the other touches), so a run has the same effect as calling the tasks in the order they
+// were added, while tasks on disjoint state run at the same time.
+struct TaskGraph {
+    static constexpr int MAX_TASKS = 16;
+    static_assert(MAX_TASKS <= 32, "dependents holds one bit per task");
+    struct Task {
+        const char *name;
+        void (*fn)();
+        ResourceMask reads, writes;
+        uint32_t dependents;   // bit per later task that waits for this one
+        uint32_t dependencies; // earlier tasks this one waits for
+    };
+
+    std::array<Task, MAX_TASKS> tasks{};
+    int count = 0;
+
+    // per run
+    std::array<std::atomic<uint32_t>, MAX_TASKS> remaining{};
+    std::atomic<uint32_t> pending{0};
+    JobSystem *system = nullptr;
+
+    void add(const char *name, void (*fn)(), ResourceMask reads, ResourceMask writes) {
+        assert(count < MAX_TASKS && "raise TaskGraph::MAX_TASKS");
+        Task &t = tasks[count];
+        t = {name, fn, reads, writes, 0, 0};
+        for (int i = 0; i < count; ++i) {
+            const Task &earlier = tasks[i];
+            if ((earlier.writes & (reads | writes)) != 0 || (earlier.reads & writes) != 0) {
+                tasks[i].dependents |= 1u << count;
+                ++t.dependencies;
+            }
+        }
+        ++count;
+    }
+
+    void run(JobSystem &js) {
+        if (js.size() == 1) {
+            for (int i = 0; i < count; ++i) tasks[i].fn(); // nobody to share with
+            return;
+        }
+        system = &js;
+        pending.store(static_cast<uint32_t>(count), std::memory_order_relaxed);
+        for (int i = 0; i < count; ++i) {
+            remaining[i].store(tasks[i].dependencies, std::memory_order_relaxed);
+        }
+        for (int i = 0; i < count; ++i) {
+            if (tasks[i].dependencies == 0) js.submit({&runTask, this, static_cast<uint32_t>(i), &pending});
+        }
+        js.wait(pending);
+    }
+
+    static void runTask(void *context, uint32_t index) {
+        auto &g = *static_cast<TaskGraph *>(context);
+        g.tasks[index].fn();
+        uint32_t dependents = g.tasks[index].dependents;
+        for (uint32_t next = index + 1; next < static_cast<uint32_t>(g.count); ++next) {
+            if ((dependents >> next & 1) == 0) continue;
+            if (g.remaining[next].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                g.system->submit({&runTask, &g, next, &g.pending});
+            }
+        }
+    }
+};
+
+// #endregion Workers
+
+// #region Telemetry
+
+// Single-producer / single-consumer lock-free ring. The producer never blocks: a full ring drops the item.
+template <typename T, size_t N> struct SpscRing {
+    static_assert((N & (N - 1)) == 0, "ring capacity must be a power of two");
+
+    std::array<T, N> items;
+    alignas(64) std::atomic<size_t> head{0}; // written by the producer
+    alignas(64) std::atomic<size_t> tail{0}; // written by the consumer
+
+    bool push(const T &item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == N) return false;
+        items[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t pop(T *out, size_t max) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t n = std::min(head.load(std::memory_order_acquire) - t, max);
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = items[(t + i) & (N - 1)];
+        }
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+};
+
+enum class TelemetryEvent : uint16_t {
+    COLLISION,      // arg = enemy CarType, x/y = enemy position, value = score
+    SCENERY_SWITCH, // arg = new SceneryType
+    BRIDGE_SPAWN,   // y = bridge height
+    FINISH,         // value = score
+    RESET,
+    SCORE_TICK, // value = score
+    DESYNC,     // arg = remote player, value = tick whose state hash differs
+};
+const char *const TELEMETRY_EVENT_NAMES[] = {"collision", "scenery_switch", "bridge_spawn", "finish",
+                                             "reset",     "score_tick",     "desync"};
+
+struct TelemetryRecord {
+    uint32_t timeMs;
+    uint16_t type;
+    uint16_t arg;
+    int64_t value;
+    float x, y;
+};
+static_assert(sizeof(TelemetryRecord) == 24, "telemetry records are fixed-size on disk");
+
+// On-disk layout: header followed by `count` records, appended in place through the mapping
+struct TelemetryHeader {
+    char magic[4]; // "CRTL"
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t dropped;
+};
+const char *const TELEMETRY_LOG_PATH = "telemetry.bin";
+const size_t TELEMETRY_GROW_BYTES = 1 << 20;
+
+struct Telemetry {
+    SpscRing<TelemetryRecord, 4096> ring;
+    MappedFile log;
+    std::thread drainer;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> dropped{0};
+
+    ~Telemetry() { stop(); }
+
+    TelemetryHeader &header() { return *reinterpret_cast<TelemetryHeader *>(log.data); }
+
+    bool start(const char *path) {
+        if (!openMapped(log, path, true, TELEMETRY_GROW_BYTES)) return false;
+        TelemetryHeader &hdr = header();
+        if (std::memcmp(hdr.magic, "CRTL", 4) != 0 || hdr.recordSize != sizeof(TelemetryRecord)) {
+            hdr = {{'C', 'R', 'T', 'L'}, 1, sizeof(TelemetryRecord), 0, 0, 0}; // new or foreign file
+        }
+        running = true;
+        drainer = std::thread([this] {
+            TRACE_THREAD("telemetry");
+            drainLoop();
+        });
+        return true;
+    }
+
+    void stop() {
+        if (!running.exchange(false)) return;
+        drainer.join();
+        closeMapped(log);
+    }
+
+    // Called on the game thread: one ring slot write, no I/O
+    void emit(TelemetryEvent type, uint16_t arg = 0, int64_t value = 0, double x = 0.0, double y = 0.0) {
+        if (resimulating || !running.load(std::memory_order_relaxed)) return;
+        TelemetryRecord rec{static_cast<uint32_t>(simTimeMs()),
+                            static_cast<uint16_t>(type),
+                            arg,
+                            value,
+                            static_cast<float>(x),
+                            static_cast<float>(y)};
+        if (!ring.push(rec)) dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Background thread: move records from the ring into the mapped log
+    void drainLoop() {
+        std::array<TelemetryRecord, 256> batch;
+        for (;;) {
+            bool stopping = !running.load();
+            size_t n = ring.pop(batch.data(), batch.size());
+            if (n > 0) append(batch.data(), n);
+            if (n == 0) {
+                if (stopping) break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+    }
+
+    void append(const TelemetryRecord *recs, size_t n) {
+        size_t offset = sizeof(TelemetryHeader) + header().count * sizeof(TelemetryRecord);
+        size_t bytes = n * sizeof(TelemetryRecord);
+        if (offset + bytes > log.size && !resizeMapped(log, log.size + TELEMETRY_GROW_BYTES)) {
+            dropped += n;
+            return;
+        }
+        std::memcpy(log.data + offset, recs, bytes);
+        header().count += n; // publish after the records are in place
+        header().dropped = dropped.load();
+    }
+};
+Telemetry telemetry;
+
+// `CarRace --telemetry-csv <log> [out.csv]`: convert a telemetry log to CSV (stdout when no output is given)
+int telemetryToCsv(const char *logPath, const char *csvPath) {
+    MappedFile log;
+    if (!openMapped(log, logPath, false)) {
+        std::cerr << "cannot open " << logPath << "\n";
+        return 1;
+    }
+    const auto &hdr = *reinterpret_cast<const TelemetryHeader *>(log.data);
+    if (log.size < sizeof(TelemetryHeader) || std::memcmp(hdr.magic, "CRTL", 4) != 0 ||
+        hdr.recordSize != sizeof(TelemetryRecord)) {
+        std::cerr << logPath << " is not a telemetry log\n";
+        closeMapped(log);
+        return 1;
+    }
+
+    FILE *out = csvPath != nullptr ? std::fopen(csvPath, "w") : stdout;
+    if (out == nullptr) {
+        std::cerr << "cannot write " << csvPath << "\n";
+        closeMapped(log);
+        return 1;
+    }
+
+    uint64_t count = std::min<uint64_t>(hdr.count, (log.size - sizeof(TelemetryHeader)) / sizeof(TelemetryRecord));
+    const auto *recs = reinterpret_cast<const TelemetryRecord *>(log.data + sizeof(TelemetryHeader));
+    std::fprintf(out, "time_ms,event,arg,value,x,y\n");
+    for (uint64_t i = 0; i < count; ++i) {
+        const TelemetryRecord &r = recs[i];
+        const char *name = r.type < std::size(TELEMETRY_EVENT_NAMES) ? TELEMETRY_EVENT_NAMES[r.type] : "unknown";
+        std::fprintf(out, "%u,%s,%u,%lld,%.4f,%.4f\n", r.timeMs, name, r.arg, static_cast<long long>(r.value), r.x,
+                     r.y);
+    }
+    if (hdr.dropped > 0) std::cerr << hdr.dropped << " events were dropped while recording\n";
+
+    if (out != stdout) std::fclose(out);
+    closeMapped(log);
+    return 0;
 }
 
-void spawnBridge() {
-    // Only spawn if current bridge is inactive
-    if (!bridge.active) {
-        bridge.y = 1.5;                                             // Spawn above visible area
-        bridge.height = BRIDGE_HEIGHT + RandReal(-0.02, 0.02)(gen); // Slight height variation
-        bridge.shadowOffset = 0.02;
-        bridge.active = true;
+// #endregion Telemetry
+
+// #region LOD
+
+// Render detail presets, lowest to highest. Scenery is always generated at the highest density and each level
+// draws a prefix, so switching levels never touches simulation state or the scenery RNG.
+struct LodLevel {
+    int segments;    // arcs in rounded rects and cacti
+    int grassBlades; // per side
+    int waves;       // per side
+    int cacti;       // per side
+    int particles;   // drawn per explosion
+    bool curbDashes; // yellow dashes on the road borders
+    double checkerCell;
+};
+constexpr std::array<LodLevel, 5> LOD_LEVELS{{
+    {4, 50, 5, 4, 8, false, 0.12},
+    {6, 100, 10, 6, 12, true, 0.06},
+    {12, 200, 15, 10, 20, true, 0.06}, // original fixed detail
+    {16, 300, 20, 13, 30, true, 0.045},
+    {24, 400, 30, 16, 40, true, 0.03},
+}};
+const LodLevel &MAX_LOD = LOD_LEVELS.back();
+const int DEFAULT_LOD = 2;
+
+// Frame-time driven level selection. An exponential moving average of the display() cost is compared with the
+// budget; the level only drops after a sustained overrun and only rises after a long stretch of headroom, so it
+// does not oscillate around the threshold.
+struct LodController {
+    double budgetMs = 1000.0 / 60.0;
+    int level = DEFAULT_LOD;
+    double avgFrameMs = 0.0;
+    int overBudgetFrames = 0;
+    int underBudgetFrames = 0;
+
+    static constexpr double SMOOTHING = 0.1;
+    static constexpr int DOWNGRADE_AFTER = 20;   // frames above budget
+    static constexpr int UPGRADE_AFTER = 120;    // frames with headroom
+    static constexpr double UPGRADE_HEADROOM = 0.6;
+
+    void frameFinished(double frameMs) {
+        avgFrameMs = avgFrameMs == 0.0 ? frameMs : avgFrameMs + SMOOTHING * (frameMs - avgFrameMs);
+
+        overBudgetFrames = avgFrameMs > budgetMs ? overBudgetFrames + 1 : 0;
+        underBudgetFrames = avgFrameMs < budgetMs * UPGRADE_HEADROOM ? underBudgetFrames + 1 : 0;
+
+        if (overBudgetFrames >= DOWNGRADE_AFTER && level > 0) {
+            --level;
+            overBudgetFrames = 0;
+        } else if (underBudgetFrames >= UPGRADE_AFTER && level + 1 < static_cast<int>(LOD_LEVELS.size())) {
+            ++level;
+            underBudgetFrames = 0;
+        }
+    }
+};
+LodController lodController;
+
+const LodLevel &lod() { return LOD_LEVELS[lodController.level]; }
+
+// #endregion LOD
+
+// #region Resolution
+
+// Dynamic resolution. While frames run over budget the world is drawn into a smaller rectangle of the framebuffer,
+// copied into a texture and stretched back over the view with linear filtering; the HUD is drawn afterwards at
+// native resolution. GL 1.1 has no framebuffer objects, so the window's own buffer is the offscreen target.
+constexpr std::array<double, 5> RESOLUTION_SCALES{0.5, 0.6, 0.7, 0.85, 1.0};
+
+// Same scheme as the LOD controller but quicker to step down, so pixel cost is shed before scenery detail
+struct ResolutionController {
+    int level = static_cast<int>(RESOLUTION_SCALES.size()) - 1;
+    double avgFrameMs = 0.0;
+    int overBudgetFrames = 0;
+    int underBudgetFrames = 0;
+
+    static constexpr double SMOOTHING = 0.2;
+    static constexpr int DOWNGRADE_AFTER = 10;  // frames above budget
+    static constexpr int UPGRADE_AFTER = 60;    // frames with headroom
+    static constexpr double UPGRADE_HEADROOM = 0.7;
+
+    double scale() const { return RESOLUTION_SCALES[level]; }
+
+    void frameFinished(double frameMs, double budgetMs) {
+        avgFrameMs = avgFrameMs == 0.0 ? frameMs : avgFrameMs + SMOOTHING * (frameMs - avgFrameMs);
+
+        overBudgetFrames = avgFrameMs > budgetMs ? overBudgetFrames + 1 : 0;
+        underBudgetFrames = avgFrameMs < budgetMs * UPGRADE_HEADROOM ? underBudgetFrames + 1 : 0;
+
+        if (overBudgetFrames >= DOWNGRADE_AFTER && level > 0) {
+            --level;
+            overBudgetFrames = 0;
+        } else if (underBudgetFrames >= UPGRADE_AFTER && level + 1 < static_cast<int>(RESOLUTION_SCALES.size())) {
+            ++level;
+            underBudgetFrames = 0;
+        }
+    }
+};
+ResolutionController resolution;
+
+// Window pixels the game occupies: the largest WIDTH:HEIGHT rectangle that fits, centred, black bars around it
+struct ViewRect {
+    int x = 0, y = 0, w = WIDTH, h = HEIGHT;
+    int windowW = WIDTH, windowH = HEIGHT;
+};
+ViewRect view;
+
+// Window pixels, origin bottom left as in GL
+struct PixelRect {
+    int x, y, w, h;
+};
+
+// What a frame changed in the window since the previous one: everything, or only the listed rectangles
+struct Damage {
+    static constexpr size_t MAX_RECTS = 8;
+    bool full = true;
+    FixedVector<PixelRect, MAX_RECTS> rects;
+};
+
+// Set by window events that may have spoilt what the window shows; the next frame repaints all of it
+bool windowDisturbed = true;
+// update() posted the coming redraw; a redraw nobody here asked for can be an expose
+bool tickRedrawPosted = false;
+
+// Largest WIDTH:HEIGHT rectangle inside the w x h area at (x, y), centred in it
+ViewRect fitView(int x, int y, int w, int h) {
+    ViewRect r;
+    r.windowW = view.windowW;
+    r.windowH = view.windowH;
+    if (w * HEIGHT > h * WIDTH) {
+        r.h = h;
+        r.w = std::max(h * WIDTH / HEIGHT, 1);
+    } else {
+        r.w = w;
+        r.h = std::max(w * HEIGHT / WIDTH, 1);
     }
+    r.x = x + (w - r.w) / 2;
+    r.y = y + (h - r.h) / 2;
+    return r;
 }
 
-void drawBridge(const Bridge &bridge) {
-    if (!bridge.active) return;
+void reshape(int w, int h) {
+    view.windowW = std::max(w, 1);
+    view.windowH = std::max(h, 1);
+    view = fitView(0, 0, view.windowW, view.windowH);
+    windowDisturbed = true;
+    glutPostRedisplay();
+}
 
-    double bridgeY = bridge.y;
-    double bridgeLeft = -1.0; // Full screen width from left edge
-    double bridgeRight = 1.0; // Full screen width to right edge
-    double bridgeTop = bridgeY + bridge.height;
-    double bridgeBottom = bridgeY;
+// Power-of-two texture (GL 1.1) at least as large as the view; only the scaled corner is ever used
+struct SceneTexture {
+    GLuint id = 0;
+    int w = 0, h = 0;
+};
+SceneTexture sceneTexture;
 
-    // Draw shadow first (darker, slightly offset)
-    glColor3d(0.1, 0.1, 0.1);
-    glBegin(GL_QUADS);
-    glVertex2d(bridgeLeft + bridge.shadowOffset, bridgeBottom - bridge.shadowOffset);
-    glVertex2d(bridgeRight + bridge.shadowOffset, bridgeBottom - bridge.shadowOffset);
-    glVertex2d(bridgeRight + bridge.shadowOffset, bridgeTop - bridge.shadowOffset);
-    glVertex2d(bridgeLeft + bridge.shadowOffset, bridgeTop - bridge.shadowOffset);
-    glEnd();
+int nextPowerOfTwo(int v) {
+    int p = 1;
+    while (p < v) p <<= 1;
+    return p;
+}
 
-    // Draw main bridge structure (concrete gray) - spans full screen width
-    glColor3d(0.3, 0.3, 0.3);
+// Start the world pass: clears the window and points the viewport at the rectangle the world is drawn into
+void beginScene(int sceneW, int sceneH) {
+    glViewport(0, 0, view.windowW, view.windowH);
+    glClearColor(0, 0, 0, 1);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glViewport(view.x, view.y, sceneW, sceneH);
+    glScissor(view.x, view.y, sceneW, sceneH);
+    glEnable(GL_SCISSOR_TEST);
+    glClearColor(0.53, 0.81, 0.92, 1);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+}
+
+// Stretch the reduced scene drawn by the world pass over the whole view
+void upscaleScene(int sceneW, int sceneH) {
+    if (sceneTexture.w < view.w || sceneTexture.h < view.h) {
+        if (sceneTexture.id == 0) glGenTextures(1, &sceneTexture.id);
+        sceneTexture.w = nextPowerOfTwo(view.w);
+        sceneTexture.h = nextPowerOfTwo(view.h);
+        glBindTexture(GL_TEXTURE_2D, sceneTexture.id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, sceneTexture.w, sceneTexture.h, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glBindTexture(GL_TEXTURE_2D, sceneTexture.id);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, view.x, view.y, sceneW, sceneH);
+
+    // half-texel inset so linear filtering never samples past the copied corner
+    double u0 = 0.5 / sceneTexture.w, v0 = 0.5 / sceneTexture.h;
+    double u1 = (sceneW - 0.5) / sceneTexture.w, v1 = (sceneH - 0.5) / sceneTexture.h;
+    glViewport(view.x, view.y, view.w, view.h);
+    glEnable(GL_TEXTURE_2D);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
     glBegin(GL_QUADS);
-    glVertex2d(bridgeLeft, bridgeBottom);
-    glVertex2d(bridgeRight, bridgeBottom);
-    glVertex2d(bridgeRight, bridgeTop);
-    glVertex2d(bridgeLeft, bridgeTop);
+    glTexCoord2d(u0, v0);
+    glVertex2d(-1, -1);
+    glTexCoord2d(u1, v0);
+    glVertex2d(1, -1);
+    glTexCoord2d(u1, v1);
+    glVertex2d(1, 1);
+    glTexCoord2d(u0, v1);
+    glVertex2d(-1, 1);
     glEnd();
+    glDisable(GL_TEXTURE_2D);
+}
 
-    // Draw bridge railings on top and bottom edges
-    double railingHeight = 0.02;
+// #endregion Resolution
+
+// #region Culling
+
+// Everything is drawn in the default [-1, 1] clip space
+struct Bounds {
+    double minX, minY, maxX, maxY;
+};
+const Bounds VIEW_BOUNDS{-1.0, -1.0, 1.0, 1.0};
+Bounds cullBounds = VIEW_BOUNDS; // narrowed to the rectangle being repainted by a partial redraw
+
+bool isVisible(const Bounds &b) {
+    return b.maxX > cullBounds.minX && b.minX < cullBounds.maxX && b.maxY > cullBounds.minY &&
+           b.minY < cullBounds.maxY;
+}
+
+struct CullStats {
+    int drawn = 0;
+    int culled = 0;
+};
+CullStats cullStats; // current frame
+
+// Visible item indices, rebuilt by cullScene() at the start of every frame; draw functions only walk these
+ArenaArray<uint32_t> visibleLeftScenery;
+ArenaArray<uint32_t> visibleRightScenery;
+ArenaArray<uint32_t> visibleEnemies;
+ArenaArray<uint32_t> visibleParticles;
+ArenaArray<uint32_t> visibleBridges;
+
+// Test rows 0..count-1 in one pass and keep the ones whose bounds touch the view; `bounds` takes a row index, so
+// it can read whichever entity columns it needs
+template <typename BoundsFn> void cullRows(size_t count, ArenaArray<uint32_t> &visible, BoundsFn bounds) {
+    visible.clear();
+    visible.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (isVisible(bounds(i))) visible.push_back(i);
+    }
+    cullStats.drawn += static_cast<int>(visible.size());
+    cullStats.culled += static_cast<int>(count - visible.size());
+}
+
+// Test `count` items in one pass and keep the indices whose bounds touch the view
+template <typename Item, typename BoundsFn>
+void cullItems(const Item *items, size_t count, ArenaArray<uint32_t> &visible, BoundsFn bounds) {
+    cullRows(count, visible, [&](uint32_t i) { return bounds(items[i]); });
+}
+
+// Repeating dashes at y = start + k * step (k = 0.. while y < end), each `len` tall and shifted by `offset`.
+// Returns the k range that can reach the view instead of testing every dash.
+struct DashRange {
+    int first, last;
+};
+
+DashRange cullDashes(double start, double end, double step, double len, double offset) {
+    int count = static_cast<int>(std::ceil((end - start) / step - 1e-9));
+    // visible when start + k * step + offset lies in (minY - len, maxY)
+    int first = std::max(0, static_cast<int>(std::floor((cullBounds.minY - len - offset - start) / step)) + 1);
+    int last = std::min(count - 1, static_cast<int>(std::ceil((cullBounds.maxY - offset - start) / step)) - 1);
+    int drawn = std::max(0, last - first + 1);
+    cullStats.drawn += drawn;
+    cullStats.culled += count - drawn;
+    return {first, last};
+}
+
+// #endregion Culling
+
+// #region Render queue
+
+// World geometry is not drawn immediately. The draw functions use rq* calls that mirror the GL immediate-mode
+// calls they replaced, and each primitive becomes a command with a 64-bit sort key. Layers keep painter's order
+// where geometry overlaps. Inside a layer, commands are grouped by primitive type and color, so all cars sharing a
+// palette color go out in one draw call. Key layout:
+//   63..56 layer | 55..48 depth inside an object | 47..44 primitive | 43..20 RGB | 19..0 unused
+enum class RenderLayer : uint8_t {
+    SCENERY_GROUND,
+    SCENERY_DETAIL,
+    ROAD,
+    ROAD_BORDER,
+    ROAD_DASHES,
+    START_FINISH,
+    CARS,
+    BRIDGE,
+    PARTICLES,
+};
+
+enum class RenderPrim : uint8_t { TRIANGLES, QUADS, LINES };
+
+struct RenderVertex {
+    float x, y;
+};
+
+struct RenderCommand {
+    uint64_t key;
+    uint32_t first; // into RenderQueue::vertices
+    uint32_t count;
+};
+
+// Where recorded geometry lands: local [-1, 1] scaled by (sx, sy) around (ox, oy). Tiled views share one
+// viewport, so each primitive is also clipped to the local square; a tile records quads as triangles for that.
+struct RenderTile {
+    float sx = 1.0f, sy = 1.0f;
+    float ox = 0.0f, oy = 0.0f;
+    bool clip = false;
+};
+
+struct RenderStats {
+    int commands = 0;
+    int drawCalls = 0;
+    int colorChanges = 0;
+};
+
+struct RenderQueue {
+    // per-frame storage lives in the frame arena
+    ArenaArray<RenderVertex> vertices;
+    ArenaArray<RenderCommand> commands;
+    ArenaArray<RenderCommand> sortScratch;
+    ArenaArray<RenderVertex> batch;
+    ArenaArray<RenderVertex> tileScratch; // a mesh placed in local coordinates, before clipping
+    RenderStats stats;
+    bool headless = false; // no GL context (scenario runs): commands are still sorted and batched, never drawn
+    RenderTile tile;       // identity outside tiled views
+
+    // immediate-mode emulation state
+    RenderLayer layer = RenderLayer::SCENERY_GROUND;
+    uint32_t color = 0;
+    int depth = 0;
+    bool inObject = false;
+    GLenum mode = GL_QUADS;
+    FixedVector<RenderVertex, 256> prim; // one primitive being recorded
+};
+RenderQueue rq;
+
+uint64_t renderKey(RenderLayer layer, int depth, RenderPrim prim, uint32_t rgb) {
+    return static_cast<uint64_t>(layer) << 56 | static_cast<uint64_t>(depth & 0xFF) << 48 |
+           static_cast<uint64_t>(prim) << 44 | static_cast<uint64_t>(rgb & 0xFFFFFF) << 20;
+}
+
+void rqLayer(RenderLayer layer) { rq.layer = layer; }
+
+// Parts of one object overlap each other, so every color change inside an object starts a new depth; across
+// objects the same depth sorts together, which is what lets identical parts of different cars batch up.
+void rqBeginObject() {
+    rq.inObject = true;
+    rq.depth = -1;
+}
+
+void rqEndObject() {
+    rq.inObject = false;
+    rq.depth = 0;
+}
+
+void rqColor3ub(uint8_t r, uint8_t g, uint8_t b) {
+    rq.color = static_cast<uint32_t>(r) << 16 | static_cast<uint32_t>(g) << 8 | b;
+    if (rq.inObject) ++rq.depth;
+}
+
+void rqColor3d(double r, double g, double b) {
+    auto channel = [](double c) { return static_cast<uint8_t>(std::lround(std::min(std::max(c, 0.0), 1.0) * 255)); };
+    rqColor3ub(channel(r), channel(g), channel(b));
+}
+
+void rqBegin(GLenum mode) {
+    rq.mode = mode;
+    rq.prim.clear();
+}
+
+void rqVertex2d(double x, double y) { rq.prim.push_back({static_cast<float>(x), static_cast<float>(y)}); }
+
+RenderVertex tileVertex(RenderVertex v) { return {rq.tile.ox + v.x * rq.tile.sx, rq.tile.oy + v.y * rq.tile.sy}; }
+
+// Sutherland-Hodgman against the four edges of the local square, then a fan in tile coordinates
+void rqTilePolygon(const RenderVertex *v, size_t n) {
+    std::array<FixedVector<RenderVertex, 264>, 2> buf; // 256 recorded vertices plus one per clip edge
+    FixedVector<RenderVertex, 264> *in = &buf[0], *out = &buf[1];
+    bool inside = true;
+    for (size_t i = 0; i < n; ++i) {
+        inside &= std::abs(v[i].x) <= 1.0f && std::abs(v[i].y) <= 1.0f;
+        in->push_back(v[i]);
+    }
+    for (int edge = 0; !inside && edge < 4 && !in->empty(); ++edge) {
+        float sign = edge < 2 ? 1.0f : -1.0f;
+        auto dist = [&](RenderVertex p) { return 1.0f - sign * (edge % 2 == 0 ? p.x : p.y); };
+        out->clear();
+        for (size_t i = 0; i < in->size(); ++i) {
+            RenderVertex p = (*in)[i], q = (*in)[(i + 1) % in->size()];
+            float dp = dist(p), dq = dist(q);
+            if (dp >= 0) out->push_back(p);
+            if ((dp >= 0) != (dq >= 0)) {
+                float t = dp / (dp - dq);
+                out->push_back({p.x + (q.x - p.x) * t, p.y + (q.y - p.y) * t});
+            }
+        }
+        std::swap(in, out);
+    }
+    const auto &a = *in;
+    for (size_t i = 1; i + 1 < a.size(); ++i) {
+        rq.vertices.push_back(tileVertex(a[0]));
+        rq.vertices.push_back(tileVertex(a[i]));
+        rq.vertices.push_back(tileVertex(a[i + 1]));
+    }
+}
+
+// Liang-Barsky against the local square
+void rqTileLine(RenderVertex p, RenderVertex q) {
+    float t0 = 0.0f, t1 = 1.0f;
+    float dx = q.x - p.x, dy = q.y - p.y;
+    const float edges[4][2] = {{-dx, p.x + 1.0f}, {dx, 1.0f - p.x}, {-dy, p.y + 1.0f}, {dy, 1.0f - p.y}};
+    for (const auto &[d, room] : edges) {
+        if (d == 0.0f) {
+            if (room < 0.0f) return;
+        } else if (d < 0.0f) {
+            t0 = std::max(t0, room / d);
+        } else {
+            t1 = std::min(t1, room / d);
+        }
+    }
+    if (t0 > t1) return;
+    rq.vertices.push_back(tileVertex({p.x + dx * t0, p.y + dy * t0}));
+    rq.vertices.push_back(tileVertex({p.x + dx * t1, p.y + dy * t1}));
+}
+
+// Append `count` local vertices of primitive `prim` to the tile and record them as one command
+void rqTileCommand(RenderPrim prim, const RenderVertex *v, size_t count) {
+    auto first = static_cast<uint32_t>(rq.vertices.size());
+    switch (prim) {
+    case RenderPrim::LINES:
+        for (size_t i = 0; i + 1 < count; i += 2) rqTileLine(v[i], v[i + 1]);
+        break;
+    case RenderPrim::QUADS:
+        for (size_t i = 0; i + 3 < count; i += 4) rqTilePolygon(v + i, 4);
+        prim = RenderPrim::TRIANGLES;
+        break;
+    case RenderPrim::TRIANGLES:
+        for (size_t i = 0; i + 2 < count; i += 3) rqTilePolygon(v + i, 3);
+        break;
+    }
+    auto n = static_cast<uint32_t>(rq.vertices.size()) - first;
+    if (n > 0) rq.commands.push_back({renderKey(rq.layer, std::max(rq.depth, 0), prim, rq.color), first, n});
+}
+
+void rqEnd() {
+    if (rq.tile.clip) {
+        const auto &v = rq.prim;
+        if (rq.mode == GL_QUADS || rq.mode == GL_LINES) {
+            rqTileCommand(rq.mode == GL_QUADS ? RenderPrim::QUADS : RenderPrim::LINES, v.data(), v.size());
+        } else if (rq.mode == GL_POLYGON || rq.mode == GL_TRIANGLE_FAN) {
+            auto first = static_cast<uint32_t>(rq.vertices.size());
+            rqTilePolygon(v.data(), v.size());
+            auto n = static_cast<uint32_t>(rq.vertices.size()) - first;
+            if (n > 0) {
+                rq.commands.push_back(
+                    {renderKey(rq.layer, std::max(rq.depth, 0), RenderPrim::TRIANGLES, rq.color), first, n});
+            }
+        }
+        return;
+    }
+
+    RenderPrim prim = RenderPrim::TRIANGLES;
+    auto first = static_cast<uint32_t>(rq.vertices.size());
+    const auto &v = rq.prim;
+
+    switch (rq.mode) {
+    case GL_QUADS:
+        prim = RenderPrim::QUADS;
+        rq.vertices.append(v.data(), v.size() - v.size() % 4);
+        break;
+    case GL_LINES:
+        prim = RenderPrim::LINES;
+        rq.vertices.append(v.data(), v.size() - v.size() % 2);
+        break;
+    case GL_POLYGON:
+    case GL_TRIANGLE_FAN: // convex, so fan triangulation covers both
+        for (size_t i = 1; i + 1 < v.size(); ++i) {
+            rq.vertices.push_back(v[0]);
+            rq.vertices.push_back(v[i]);
+            rq.vertices.push_back(v[i + 1]);
+        }
+        break;
+    default:
+        return;
+    }
+
+    auto count = static_cast<uint32_t>(rq.vertices.size()) - first;
+    if (count > 0) rq.commands.push_back({renderKey(rq.layer, std::max(rq.depth, 0), prim, rq.color), first, count});
+}
+
+// Copy a prebuilt vertex block, scaled by (sx, sy) and moved to (x, y), as one command
+void rqMesh(RenderPrim prim, const RenderVertex *v, uint32_t count, double x, double y, double sx, double sy) {
+    if (rq.tile.clip) {
+        rq.tileScratch.resize(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            rq.tileScratch[i] = {static_cast<float>(x + v[i].x * sx), static_cast<float>(y + v[i].y * sy)};
+        }
+        rqTileCommand(prim, rq.tileScratch.data(), count);
+        return;
+    }
+
+    auto first = static_cast<uint32_t>(rq.vertices.size());
+    rq.vertices.resize(first + count);
+    RenderVertex *out = rq.vertices.data() + first;
+    for (uint32_t i = 0; i < count; ++i) {
+        out[i] = {static_cast<float>(x + v[i].x * sx), static_cast<float>(y + v[i].y * sy)};
+    }
+    rq.commands.push_back({renderKey(rq.layer, std::max(rq.depth, 0), prim, rq.color), first, count});
+}
+
+void rqBeginFrame() {
+    rq.vertices.clear();
+    rq.commands.clear();
+    rq.sortScratch.clear();
+    rq.batch.clear();
+    rq.tileScratch.clear();
+    rq.stats = {};
+}
+
+// Stable LSD radix sort on the used key bits (63..16), skipping digits that are the same for every command
+void rqSort() {
+    auto &src = rq.commands;
+    auto &dst = rq.sortScratch;
+    dst.resize(src.size());
+
+    for (int shift = 16; shift < 64; shift += 8) {
+        std::array<uint32_t, 256> offsets{};
+        for (const auto &c : src) {
+            ++offsets[(c.key >> shift) & 0xFF];
+        }
+        if (std::find(offsets.begin(), offsets.end(), src.size()) != offsets.end()) continue; // one bucket only
+
+        uint32_t sum = 0;
+        for (auto &o : offsets) {
+            uint32_t n = o;
+            o = sum;
+            sum += n;
+        }
+        for (const auto &c : src) {
+            dst[offsets[(c.key >> shift) & 0xFF]++] = c;
+        }
+        src.swap(dst);
+    }
+}
+
+// Sort and submit the frame: one glDrawArrays per run of commands with the same primitive and color
+void rqFlush() {
+    TRACE_FUNCTION();
+    rqSort();
+    rq.stats.commands = static_cast<int>(rq.commands.size());
+
+    if (!rq.headless) glEnableClientState(GL_VERTEX_ARRAY);
+    uint32_t currentColor = UINT32_MAX;
+    const auto &cmds = rq.commands;
+    for (size_t i = 0; i < cmds.size();) {
+        uint64_t batchKey = cmds[i].key & (uint64_t{0xFFFFFFF} << 20); // primitive + color
+        rq.batch.clear();
+        size_t j = i;
+        for (; j < cmds.size() && (cmds[j].key & (uint64_t{0xFFFFFFF} << 20)) == batchKey; ++j) {
+            const auto *v = rq.vertices.data() + cmds[j].first;
+            rq.batch.append(v, cmds[j].count);
+        }
+
+        auto rgb = static_cast<uint32_t>(batchKey >> 20) & 0xFFFFFF;
+        if (rgb != currentColor) {
+            if (!rq.headless) glColor3ub(rgb >> 16, (rgb >> 8) & 0xFF, rgb & 0xFF);
+            currentColor = rgb;
+            ++rq.stats.colorChanges;
+        }
+
+        static const GLenum modes[] = {GL_TRIANGLES, GL_QUADS, GL_LINES};
+        if (!rq.headless) {
+            glVertexPointer(2, GL_FLOAT, 0, rq.batch.data());
+            glDrawArrays(modes[(batchKey >> 44) & 0xF], 0, static_cast<GLsizei>(rq.batch.size()));
+        }
+        ++rq.stats.drawCalls;
+        i = j;
+    }
+    if (!rq.headless) glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+// #endregion Render queue
+
+// #region Scenery
+
+// ----- Grass -----
+FixedVector<std::pair<double, double>, 400> leftGrassBlades;
+FixedVector<std::pair<double, double>, 400> rightGrassBlades;
+
+void initGrass() {
+    leftGrassBlades.clear();
+    rightGrassBlades.clear();
+    int numBlades = MAX_LOD.grassBlades;
+    RandReal xDist(-1.0, -roadWidth / 2 - 0.05);
+    RandReal yDist(-1.0, 1.0);
+    for (int i = 0; i < numBlades; ++i) {
+        leftGrassBlades.emplace_back(xDist(sceneryGen), yDist(sceneryGen));
+        rightGrassBlades.emplace_back(-xDist(sceneryGen), yDist(sceneryGen));
+    }
+}
+
+void drawGrass() {
+    TRACE_FUNCTION();
+    rqLayer(RenderLayer::SCENERY_GROUND);
+    rqColor3ub(46, 111, 64);
+
+    rqBegin(GL_QUADS);
+    rqVertex2d(-1.0, -1.0);
+    rqVertex2d(-roadWidth / 2, -1.0);
+    rqVertex2d(-roadWidth / 2, 1.0);
+    rqVertex2d(-1.0, 1.0);
+    rqEnd();
+
+    rqBegin(GL_QUADS);
+    rqVertex2d(roadWidth / 2, -1.0);
+    rqVertex2d(1.0, -1.0);
+    rqVertex2d(1.0, 1.0);
+    rqVertex2d(roadWidth / 2, 1.0);
+    rqEnd();
+
+    rqLayer(RenderLayer::SCENERY_DETAIL);
+    rqColor3ub(104, 186, 127);
+    for (uint32_t i : visibleLeftScenery) {
+        const auto &blade = leftGrassBlades[i];
+        rqBegin(GL_LINES);
+        rqVertex2d(blade.first, blade.second);
+        rqVertex2d(blade.first + 0.01, blade.second + 0.03);
+        rqEnd();
+    }
+    for (uint32_t i : visibleRightScenery) {
+        const auto &blade = rightGrassBlades[i];
+        rqBegin(GL_LINES);
+        rqVertex2d(blade.first, blade.second);
+        rqVertex2d(blade.first - 0.01, blade.second + 0.03);
+        rqEnd();
+    }
+}
+
+void updateGrass() {
+    TRACE_FUNCTION();
+    for (auto &[x, y] : leftGrassBlades) {
+        y -= 0.01;
+        if (y < -1.0) y = 1.0;
+    }
+    for (auto &[x, y] : rightGrassBlades) {
+        y -= 0.01;
+        if (y < -1.0) y = 1.0;
+    }
+}
+
+// ----- Desert -----
+struct Cactus {
+    double x, y;
+    double size;
+};
+FixedVector<Cactus, 16> leftCt;
+FixedVector<Cactus, 16> rightCt;
+
+// ----- River -----
+struct WavePoint {
+    double x, y;
+    double amplitude;
+    double frequency;
+    double phase;
+};
+
+FixedVector<WavePoint, 30> leftWaves;
+FixedVector<WavePoint, 30> rightWaves;
+double waveTime = 0.0;
+
+void initRiver() {
+    leftWaves.clear();
+    rightWaves.clear();
+    waveTime = 0.0;
+
+    // Initialize wave points for left side
+    int numWaves = MAX_LOD.waves;
+    RandReal xLeft(-1.0, -roadWidth / 2 - 0.05);
+    RandReal yDist(-1.0, 1.0);
+    RandReal ampDist(0.02, 0.05);
+    RandReal freqDist(1.0, 3.0);
+    RandReal phaseDist(0.0, 2.0 * PI);
+
+    for (int i = 0; i < numWaves; ++i) {
+        leftWaves.push_back({
+            xLeft(sceneryGen),
+            yDist(sceneryGen),
+            ampDist(sceneryGen),
+            freqDist(sceneryGen),
+            phaseDist(sceneryGen),
+        });
+    }
+
+    // Initialize wave points for right side
+    RandReal xRight(roadWidth / 2 + 0.05, 1.0);
+    for (int i = 0; i < numWaves; ++i) {
+        rightWaves.push_back({
+            xRight(sceneryGen),
+            yDist(sceneryGen),
+            ampDist(sceneryGen),
+            freqDist(sceneryGen),
+            phaseDist(sceneryGen),
+        });
+    }
+}
+
+void drawRiver() {
+    TRACE_FUNCTION();
+    // Draw water background (deep blue)
+    rqLayer(RenderLayer::SCENERY_GROUND);
+    rqColor3ub(30, 144, 255);
+
+    // Left water area
+    rqBegin(GL_QUADS);
+    rqVertex2d(-1.0, -1.0);
+    rqVertex2d(-roadWidth / 2, -1.0);
+    rqVertex2d(-roadWidth / 2, 1.0);
+    rqVertex2d(-1.0, 1.0);
+    rqEnd();
+
+    // Right water area
+    rqBegin(GL_QUADS);
+    rqVertex2d(roadWidth / 2, -1.0);
+    rqVertex2d(1.0, -1.0);
+    rqVertex2d(1.0, 1.0);
+    rqVertex2d(roadWidth / 2, 1.0);
+    rqEnd();
+
+    // Draw animated waves
+    rqLayer(RenderLayer::SCENERY_DETAIL);
+    rqColor3ub(135, 206, 250); // Light blue for waves
+    for (uint32_t i : visibleLeftScenery) {
+        const auto &wave = leftWaves[i];
+        double waveY = wave.y + wave.amplitude * sin(wave.frequency * waveTime + wave.phase);
+        rqBegin(GL_LINES);
+        rqVertex2d(wave.x - 0.05, waveY);
+        rqVertex2d(wave.x + 0.05, waveY);
+        rqEnd();
+    }
+
+    for (uint32_t i : visibleRightScenery) {
+        const auto &wave = rightWaves[i];
+        double waveY = wave.y + wave.amplitude * sin(wave.frequency * waveTime + wave.phase);
+        rqBegin(GL_LINES);
+        rqVertex2d(wave.x - 0.05, waveY);
+        rqVertex2d(wave.x + 0.05, waveY);
+        rqEnd();
+    }
+}
+
+void updateRiver() {
+    TRACE_FUNCTION();
+    waveTime += 0.05; // Increment wave animation time
+}
+
+void drawCactus(double x, double y, double size) {
+    rqColor3ub(34, 139, 34);
+    int segments = lod().segments;
+
+    // Draw circular base of the cactus
+    rqBegin(GL_TRIANGLE_FAN);
+    rqVertex2d(x, y); // Center point
+    for (int i = 0; i <= segments; ++i) {
+        double angle = 2.0 * PI * i / segments;
+        double dx = size * 0.3 * cos(angle);
+        double dy = size * 0.3 * sin(angle);
+        rqVertex2d(x + dx, y + dy);
+    }
+    rqEnd();
+
+    // Draw spikes (starburst effect)
+    rqBegin(GL_LINES);
+    for (int i = 0; i < segments; ++i) {
+        double angle = 2.0 * PI * i / segments;
+        double dx = size * 0.35 * cos(angle);
+        double dy = size * 0.35 * sin(angle);
+        rqVertex2d(x, y);
+        rqVertex2d(x + dx, y + dy);
+    }
+    rqEnd();
+}
+
+void initDesert() {
+    leftCt.clear();
+    rightCt.clear();
+    int num = MAX_LOD.cacti;
+    RandReal xLeft(-1.0, -roadWidth / 2 - 0.05);
+    RandReal xRight(roadWidth / 2 + 0.05, 1.0);
+    RandReal yDist(-1.0, 1.0);
+    RandReal sDist(0.05, 0.2);
+    for (int i = 0; i < num; ++i) {
+        leftCt.push_back({xLeft(sceneryGen), yDist(sceneryGen), sDist(sceneryGen)});
+        rightCt.push_back({xRight(sceneryGen), yDist(sceneryGen), sDist(sceneryGen)});
+    }
+}
+
+void drawDesert() {
+    TRACE_FUNCTION();
+    rqLayer(RenderLayer::SCENERY_GROUND);
+    rqColor3ub(237, 201, 175);
+    rqBegin(GL_QUADS); // left sand
+    rqVertex2d(-1.0, -1.0);
+    rqVertex2d(-roadWidth / 2, -1.0);
+    rqVertex2d(-roadWidth / 2, 1.0);
+    rqVertex2d(-1.0, 1.0);
+    rqEnd();
+    rqBegin(GL_QUADS); // right sand
+    rqVertex2d(roadWidth / 2, -1.0);
+    rqVertex2d(1.0, -1.0);
+    rqVertex2d(1.0, 1.0);
+    rqVertex2d(roadWidth / 2, 1.0);
+    rqEnd();
+    rqLayer(RenderLayer::SCENERY_DETAIL);
+    for (uint32_t i : visibleLeftScenery) {
+        drawCactus(leftCt[i].x, leftCt[i].y, leftCt[i].size);
+    }
+    for (uint32_t i : visibleRightScenery) {
+        drawCactus(rightCt[i].x, rightCt[i].y, rightCt[i].size);
+    }
+}
+
+void updateDesert() {
+    TRACE_FUNCTION();
+    for (auto &c : leftCt) {
+        c.y -= 0.01;
+        if (c.y < -1.0) c.y = 1.0;
+    }
+    for (auto &c : rightCt) {
+        c.y -= 0.01;
+        if (c.y < -1.0) c.y = 1.0;
+    }
+}
+
+// Scenery state is rebuilt from the generator state at init plus the number of updates since, which is all a
+// snapshot needs to store
+Pcg32 sceneryInitGen;
+uint32_t sceneryTicks = 0;
+uint32_t sceneryGeneration = 0; // bumped by every initScenery(), so redraws can tell a rebuilt landscape apart
+
+// Scenery
+void initScenery(SceneryType t) {
+    TRACE_FUNCTION();
+    sceneryInitGen = sceneryGen;
+    sceneryTicks = 0;
+    ++sceneryGeneration;
+    switch (t) {
+    case SceneryType::GRASS:
+        initGrass();
+        break;
+    case SceneryType::DESERT:
+        initDesert();
+        break;
+    case SceneryType::RIVER:
+        initRiver();
+        break;
+    }
+}
+
+void drawScenery() {
+    TRACE_FUNCTION();
+    switch (currentScenery) {
+    case SceneryType::GRASS:
+        drawGrass();
+        break;
+    case SceneryType::DESERT:
+        drawDesert();
+        break;
+    case SceneryType::RIVER:
+        drawRiver();
+        break;
+    }
+}
+
+void updateScenery() {
+    TRACE_FUNCTION();
+    ++sceneryTicks;
+    switch (currentScenery) {
+    case SceneryType::GRASS:
+        updateGrass();
+        break;
+    case SceneryType::DESERT:
+        updateDesert();
+        break;
+    case SceneryType::RIVER:
+        updateRiver();
+        break;
+    }
+}
+
+void switchScenery(SceneryType t) {
+    currentScenery = t;
+    initScenery(currentScenery);
+    telemetry.emit(TelemetryEvent::SCENERY_SWITCH, static_cast<uint16_t>(t));
+}
+
+// #endregion
+
+// #region Road
+
+Coord laneOffset{0.0};
+Coord roadScroll{0.0};          // non-wrapping scroll accumulator for anchored features
+Coord startScroll0{0.0};        // roadScroll value at game start
+Coord finishScroll0{0.0};       // roadScroll value when finish line spawns
+const Coord ROAD_SPEED{0.02};   // per tick
+bool finishLineSpawned = false; // indicates if finish line has been spawned
+const int MAX_LANES = 16;
+FixedVector<Coord, MAX_LANES> lanes;
+RandInt laneDist;
+
+void initRoad() {
+    int numLanes = std::min(static_cast<int>(roadWidth / carWidth), MAX_LANES);
+    lanes.clear();
+    double laneSpacing = roadWidth / numLanes;
+    double startX = -roadWidth / 2 + laneSpacing / 2;
+    for (int i = 0; i < numLanes; ++i) {
+        lanes.push_back(Coord{startX + i * laneSpacing});
+    }
+    laneDist = RandInt(0, numLanes - 1);
+}
+
+void drawRoad() {
+    TRACE_FUNCTION();
+    // road
+    rqLayer(RenderLayer::ROAD);
+    rqColor3d(0.2, 0.2, 0.2);
+    rqBegin(GL_QUADS);
+    rqVertex2d(-roadWidth / 2, -1.0);
+    rqVertex2d(roadWidth / 2, -1.0);
+    rqVertex2d(roadWidth / 2, 1.0);
+    rqVertex2d(-roadWidth / 2, 1.0);
+    rqEnd();
+
+    // road borders
+    rqLayer(RenderLayer::ROAD_BORDER);
+    rqColor3d(0.8, 0.8, 0.8);
+
+    rqBegin(GL_QUADS);
+    rqVertex2d(-roadWidth / 2 - 0.02, -1.0);
+    rqVertex2d(-roadWidth / 2, -1.0);
+    rqVertex2d(-roadWidth / 2, 1.0);
+    rqVertex2d(-roadWidth / 2 - 0.02, 1.0);
+    rqEnd();
+
+    rqBegin(GL_QUADS);
+    rqVertex2d(roadWidth / 2, -1.0);
+    rqVertex2d(roadWidth / 2 + 0.02, -1.0);
+    rqVertex2d(roadWidth / 2 + 0.02, 1.0);
+    rqVertex2d(roadWidth / 2, 1.0);
+    rqEnd();
+
+    rqLayer(RenderLayer::ROAD_DASHES);
+    DashRange curb = lod().curbDashes ? cullDashes(-1.4, 1.4, 0.1, 0.05, laneOffset) : DashRange{0, -1};
+    for (int k = curb.first; k <= curb.last; ++k) {
+        double y = -1.4 + k * 0.1;
+        rqColor3d(1, 0.85, 0.2);
+
+        rqBegin(GL_QUADS);
+        rqVertex2d(-roadWidth / 2 - 0.02, y + laneOffset);
+        rqVertex2d(-roadWidth / 2, y + laneOffset);
+        rqVertex2d(-roadWidth / 2, y + 0.05 + laneOffset);
+        rqVertex2d(-roadWidth / 2 - 0.02, y + 0.05 + laneOffset);
+        rqEnd();
+
+        rqBegin(GL_QUADS);
+        rqVertex2d(roadWidth / 2, y + laneOffset);
+        rqVertex2d(roadWidth / 2 + 0.02, y + laneOffset);
+        rqVertex2d(roadWidth / 2 + 0.02, y + 0.05 + laneOffset);
+        rqVertex2d(roadWidth / 2, y + 0.05 + laneOffset);
+        rqEnd();
+    }
+
+    // lane markings
+    rqColor3d(1, 1, 1);
+    DashRange lane = cullDashes(-1.4, 1.4, 0.2, 0.1, laneOffset);
+    for (int k = lane.first; k <= lane.last; ++k) {
+        double y = -1.4 + k * 0.2;
+        rqBegin(GL_QUADS);
+        rqVertex2d(-0.01, y + laneOffset);
+        rqVertex2d(0.01, y + laneOffset);
+        rqVertex2d(0.01, y + 0.1 + laneOffset);
+        rqVertex2d(-0.01, y + 0.1 + laneOffset);
+        rqEnd();
+    }
+
+    // start/finish lines
+    rqLayer(RenderLayer::START_FINISH);
+    int now = simTimeMs();
+    int elapsed = now - gameStartTimeMs;
+
+    auto drawCheckeredLine = [&](double baseY, double height, double cellW) {
+        double left = -roadWidth / 2.0;
+        int cells = static_cast<int>(roadWidth / cellW) + 1;
+        for (int i = 0; i < cells; ++i) {
+            if (i % 2 == 0)
+                rqColor3d(1, 1, 1);
+            else
+                rqColor3d(0, 0, 0);
+            double x0 = left + i * cellW;
+            double x1 = x0 + cellW;
+            rqBegin(GL_QUADS);
+            rqVertex2d(x0, baseY);
+            rqVertex2d(x1, baseY);
+            rqVertex2d(x1, baseY + height);
+            rqVertex2d(x0, baseY + height);
+            rqEnd();
+        }
+    };
+
+    // Show start line only for a short time at game start
+    if (elapsed <= START_LINE_SHOW_MS) {
+        double startY = -0.6 + (roadScroll - startScroll0);
+        drawCheckeredLine(startY, 0.06, lod().checkerCell);
+    }
+
+    // Show finish line after a certain amount of time
+    if (finishLineSpawned) {
+        double finishY = 0.7 + (roadScroll - finishScroll0);
+        drawCheckeredLine(finishY, 0.06, lod().checkerCell);
+    }
+}
+
+void updateRoad() {
+    TRACE_FUNCTION();
+    laneOffset -= ROAD_SPEED; // moves road lane markings down
+    if (laneOffset < -0.4) laneOffset = Coord{0.0};
+
+    roadScroll -= ROAD_SPEED; // non-wrapping scroll for anchored features
+}
+
+// #endregion Road
+
+// #region Car
+
+enum class CarType { SEDAN, SUV, TRACK };
+const int CAR_TYPE_COUNT = 3;
+
+// Car types are data: a table of parts in multiples of carWidth / carHeight, each colored from the car's paint
+// (paint * mul + add per channel). The tables are expanded into vertex blocks at compile time, one per LOD level,
+// so drawing a car only copies a static block into the render queue, scaled and moved into place. Round corners
+// depend on the car's proportions; rebuildCarMeshes() re-expands the blocks when carWidth / carHeight change.
+enum class CarPartShape : uint8_t { QUAD, ROUNDED_RECT };
+
+struct CarColor {
+    double mul[3];
+    double add[3];
+};
+
+constexpr bool operator==(const CarColor &a, const CarColor &b) {
+    for (int i = 0; i < 3; ++i) {
+        if (a.mul[i] != b.mul[i] || a.add[i] != b.add[i]) return false;
+    }
+    return true;
+}
+
+constexpr CarColor PAINT{{1, 1, 1}, {0, 0, 0}};
+constexpr CarColor PAINT_SHADE{{0.8, 0.8, 0.8}, {0, 0, 0}};
+constexpr CarColor PAINT_TRUNK{{0.2, 0.6, 0.9}, {0, 0, 0}};
+constexpr CarColor GLASS{{0, 0, 0}, {0.5, 0.8, 1}};
+constexpr CarColor HEADLIGHT{{0, 0, 0}, {1, 1, 0}};
+constexpr CarColor TAILLIGHT{{0, 0, 0}, {1, 0, 0}};
+constexpr CarColor TIRE{{0, 0, 0}, {0.1, 0.1, 0.1}};
+
+struct CarPart {
+    CarPartShape shape;
+    CarColor color;
+    double v[8]; // QUAD: four x, y corners; ROUNDED_RECT: left, bottom, right, top, corner radius in carWidths
+};
+
+constexpr CarPart carQuad(CarColor color, double x0, double y0, double x1, double y1, double x2, double y2,
+                          double x3, double y3) {
+    return {CarPartShape::QUAD, color, {x0, y0, x1, y1, x2, y2, x3, y3}};
+}
+
+constexpr CarPart carRect(CarColor color, double left, double bottom, double right, double top) {
+    return carQuad(color, left, bottom, right, bottom, right, top, left, top);
+}
+
+constexpr CarPart carRoundedRect(CarColor color, double left, double bottom, double right, double top,
+                                 double radius) {
+    return {CarPartShape::ROUNDED_RECT, color, {left, bottom, right, top, radius, 0, 0, 0}};
+}
+
+// Parts are drawn in table order; consecutive parts with the same color share one render command.
+template <size_t N>
+constexpr std::array<CarPart, N + 4> withWheels(const std::array<CarPart, N> &parts) {
+    std::array<CarPart, N + 4> out{};
+    for (size_t i = 0; i < N; ++i) out[i] = parts[i];
+    out[N] = carRect(TIRE, -0.55, 0.2, -0.5, 0.6);
+    out[N + 1] = carRect(TIRE, 0.5, 0.2, 0.55, 0.6);
+    out[N + 2] = carRect(TIRE, -0.55, -0.9, -0.5, -0.5);
+    out[N + 3] = carRect(TIRE, 0.5, -0.9, 0.55, -0.5);
+    return out;
+}
+
+template <CarType T>
+struct CarDef;
+
+template <>
+struct CarDef<CarType::SEDAN> {
+    static constexpr auto parts = withWheels<7>({{
+        carRect(PAINT, -0.5, -1, 0.5, 0.75), // body
+        carRect(PAINT_SHADE, -0.4, -0.75, 0.4, 0.2), // roof
+        carQuad(GLASS, -0.4, 0.15, 0.4, 0.15, 0.35, 0.5, -0.35, 0.5), // windshield
+        carRect(HEADLIGHT, -0.5, 0.75, -0.2, 0.8), // left front
+        carRect(HEADLIGHT, 0.2, 0.75, 0.5, 0.8), // right front
+        carRect(TAILLIGHT, -0.5, -1.05, -0.2, -1), // left rear
+        carRect(TAILLIGHT, 0.2, -1.05, 0.5, -1), // right rear
+    }});
+};
+
+template <>
+struct CarDef<CarType::SUV> {
+    static constexpr auto parts = withWheels<7>({{
+        carRoundedRect(PAINT, -0.5, -1.1, 0.5, 0.825, 0.1), // body
+        carRect(PAINT_SHADE, -0.45, -0.75, 0.45, 0.3), // roof
+        carQuad(GLASS, -0.45, 0.25, 0.45, 0.25, 0.4, 0.5, -0.4, 0.5), // windshield
+        carRect(HEADLIGHT, -0.5, 0.7, -0.3, 0.8), // left front
+        carRect(HEADLIGHT, 0.3, 0.7, 0.5, 0.8), // right front
+        carRect(TAILLIGHT, -0.5, -1.1, -0.3, -1), // left rear
+        carRect(TAILLIGHT, 0.3, -1.1, 0.5, -1), // right rear
+    }});
+};
+
+template <>
+struct CarDef<CarType::TRACK> {
+    static constexpr auto parts = withWheels<8>({{
+        carRect(PAINT, -0.5, -1, 0.5, 0.75), // body
+        carRect(PAINT_SHADE, -0.4, -0.75, 0.4, 0.35), // roof
+        carRect(PAINT_TRUNK, -0.45, -0.9, 0.45, -0.05), // trunk
+        carQuad(GLASS, -0.4, 0.35, 0.4, 0.35, 0.35, 0.6, -0.35, 0.6), // windshield
+        carRect(HEADLIGHT, -0.5, 0.75, -0.2, 0.8), // left front
+        carRect(HEADLIGHT, 0.2, 0.75, 0.5, 0.8), // right front
+        carRect(TAILLIGHT, -0.5, -1.05, -0.2, -1), // left rear
+        carRect(TAILLIGHT, 0.2, -1.05, 0.5, -1), // right rear
+    }});
+};
+
+// std::sin / std::cos are not constexpr; a Taylor series is exact to float precision after range reduction
+constexpr double constSin(double x) {
+    while (x > PI) x -= 2 * PI;
+    while (x < -PI) x += 2 * PI;
+    double term = x;
+    double sum = x;
+    for (int n = 1; n < 12; ++n) {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double constCos(double x) { return constSin(x + PI / 2); }
+
+constexpr RenderPrim carPartPrim(const CarPart &p) {
+    return p.shape == CarPartShape::QUAD ? RenderPrim::QUADS : RenderPrim::TRIANGLES;
+}
+
+// Rounded rect outline: `segments` + 1 points per corner, counter-clockwise from the top-right corner. `aspect` is
+// carWidth / carHeight, which turns the radius into carHeights so the corners stay circular.
+constexpr int roundedRectPoints(int segments) { return 4 * (segments + 1); }
+
+constexpr RenderVertex roundedRectPoint(const CarPart &p, int segments, double aspect, int k) {
+    int corner = k / (segments + 1);
+    int j = k % (segments + 1);
+    double left = p.v[0], bottom = p.v[1], right = p.v[2], top = p.v[3], rx = p.v[4], ry = p.v[4] * aspect;
+    double cx = corner == 0 || corner == 3 ? right - rx : left + rx;
+    double cy = corner < 2 ? top - ry : bottom + ry;
+    double theta = corner * (PI / 2) + (PI / 2) * j / segments;
+    return {static_cast<float>(cx + rx * constCos(theta)), static_cast<float>(cy + ry * constSin(theta))};
+}
+
+constexpr size_t carPartVertices(const CarPart &p, int segments) {
+    return p.shape == CarPartShape::QUAD ? 4 : 3 * static_cast<size_t>(roundedRectPoints(segments) - 2);
+}
+
+template <size_t P>
+constexpr size_t carMeshVertexCount(const std::array<CarPart, P> &parts, int segments) {
+    size_t n = 0;
+    for (const CarPart &p : parts) n += carPartVertices(p, segments);
+    return n;
+}
+
+constexpr bool startsRange(const CarPart *parts, size_t i) {
+    return i == 0 || carPartPrim(parts[i]) != carPartPrim(parts[i - 1]) || !(parts[i].color == parts[i - 1].color);
+}
+
+template <size_t P>
+constexpr size_t carMeshRangeCount(const std::array<CarPart, P> &parts) {
+    size_t n = 0;
+    for (size_t i = 0; i < P; ++i) n += startsRange(parts.data(), i);
+    return n;
+}
+
+// One render command's worth of vertices sharing a color
+struct CarMeshRange {
+    CarColor color;
+    RenderPrim prim;
+    uint32_t first, count;
+};
+
+template <size_t V, size_t R>
+struct CarMeshData {
+    std::array<RenderVertex, V> vertices;
+    std::array<CarMeshRange, R> ranges;
+};
+
+template <size_t V, size_t R, size_t P>
+constexpr CarMeshData<V, R> expandCarParts(const std::array<CarPart, P> &parts, int segments, double aspect) {
+    CarMeshData<V, R> mesh{};
+    size_t v = 0;
+    size_t r = 0;
+    for (size_t i = 0; i < P; ++i) {
+        const CarPart &p = parts[i];
+        if (startsRange(parts.data(), i)) mesh.ranges[r++] = {p.color, carPartPrim(p), static_cast<uint32_t>(v), 0};
+
+        if (p.shape == CarPartShape::QUAD) {
+            for (int k = 0; k < 4; ++k) {
+                mesh.vertices[v++] = {static_cast<float>(p.v[2 * k]), static_cast<float>(p.v[2 * k + 1])};
+            }
+        } else { // convex, so fan triangulation
+            for (int k = 1; k + 1 < roundedRectPoints(segments); ++k) {
+                mesh.vertices[v++] = roundedRectPoint(p, segments, aspect, 0);
+                mesh.vertices[v++] = roundedRectPoint(p, segments, aspect, k);
+                mesh.vertices[v++] = roundedRectPoint(p, segments, aspect, k + 1);
+            }
+        }
+        mesh.ranges[r - 1].count = static_cast<uint32_t>(v) - mesh.ranges[r - 1].first;
+    }
+    return mesh;
+}
+
+// Expanded at compile time for the default proportions; `data` is what gets drawn
+template <CarType T, int Lod>
+struct CarMesh {
+    static constexpr auto &parts = CarDef<T>::parts;
+    static constexpr int segments = LOD_LEVELS[Lod].segments;
+    static constexpr size_t vertexCount = carMeshVertexCount(parts, segments);
+    static constexpr size_t rangeCount = carMeshRangeCount(parts);
+    static inline auto data =
+        expandCarParts<vertexCount, rangeCount>(parts, segments, DEFAULT_CAR_WIDTH / DEFAULT_CAR_HEIGHT);
+
+    static void rebuild(double aspect) { data = expandCarParts<vertexCount, rangeCount>(parts, segments, aspect); }
+};
+
+// Type-erased view of one expanded mesh
+struct CarMeshView {
+    const RenderVertex *vertices;
+    const CarMeshRange *ranges;
+    size_t vertexCount;
+    size_t rangeCount;
+};
+
+template <CarType T, size_t... Lod>
+constexpr std::array<CarMeshView, sizeof...(Lod)> carMeshLods(std::index_sequence<Lod...>) {
+    return {{{CarMesh<T, Lod>::data.vertices.data(), CarMesh<T, Lod>::data.ranges.data(),
+              CarMesh<T, Lod>::data.vertices.size(), CarMesh<T, Lod>::data.ranges.size()}...}};
+}
+
+constexpr std::array<std::array<CarMeshView, LOD_LEVELS.size()>, CAR_TYPE_COUNT> CAR_MESHES{{
+    carMeshLods<CarType::SEDAN>(std::make_index_sequence<LOD_LEVELS.size()>{}),
+    carMeshLods<CarType::SUV>(std::make_index_sequence<LOD_LEVELS.size()>{}),
+    carMeshLods<CarType::TRACK>(std::make_index_sequence<LOD_LEVELS.size()>{}),
+}};
+
+const CarMeshView &carMesh(CarType type, int level) { return CAR_MESHES[static_cast<int>(type)][level]; }
+
+template <CarType T, size_t... Lod> void rebuildCarMeshLods(double aspect, std::index_sequence<Lod...>) {
+    (CarMesh<T, Lod>::rebuild(aspect), ...);
+}
+
+// Re-expand every mesh for the current carWidth / carHeight; the vertex and range counts do not change
+void rebuildCarMeshes() {
+    double aspect = carWidth / carHeight;
+    auto lods = std::make_index_sequence<LOD_LEVELS.size()>{};
+    rebuildCarMeshLods<CarType::SEDAN>(aspect, lods);
+    rebuildCarMeshLods<CarType::SUV>(aspect, lods);
+    rebuildCarMeshLods<CarType::TRACK>(aspect, lods);
+}
+
+void drawCar(double x, double y, double r, double g, double b, CarType type = CarType::SEDAN) {
+    const CarMeshView &mesh = carMesh(type, lodController.level);
+
+    rqLayer(RenderLayer::CARS);
+    rqBeginObject();
+    for (size_t i = 0; i < mesh.rangeCount; ++i) {
+        const CarMeshRange &range = mesh.ranges[i];
+        const CarColor &c = range.color;
+        rqColor3d(r * c.mul[0] + c.add[0], g * c.mul[1] + c.add[1], b * c.mul[2] + c.add[2]);
+        rqMesh(range.prim, mesh.vertices + range.first, range.count, x, y, carWidth, carHeight);
+    }
+    rqEndObject();
+}
+
+// #endregion Car
+
+// #region Collision
+
+// Each car type's silhouette is rasterized once into a 64x64 bit mask (one uint64_t per row, bit 0 = leftmost
+// column). All masks share the same local frame so the narrowphase only needs an integer cell offset.
+const int MASK_COLS = 64;
+const int MASK_ROWS = 64;
+
+// Silhouette extent in multiples of carWidth / carHeight (covers wheels, lamps and the SUV's longer body)
+const double MASK_MIN_X = -0.55;
+const double MASK_MAX_X = 0.55;
+const double MASK_MIN_Y = -1.1;
+const double MASK_MAX_Y = 0.85;
+
+const CarType PLAYER_CAR_TYPE = CarType::SEDAN;
+
+struct CarMask {
+    std::array<uint64_t, MASK_ROWS> rows;
+    int firstRow, lastRow;        // non-empty row range
+    Coord minX, maxX, minY, maxY; // tight bounds relative to the car center
+};
+
+std::array<CarMask, CAR_TYPE_COUNT> carMasks;
+Coord maskCellW{0.0};
+Coord maskCellH{0.0};
+
+// Point inside a convex polygon of either winding; edges count as inside
+bool insideConvex(double px, double py, const RenderVertex *v, int n) {
+    bool above = false;
+    bool below = false;
+    for (int i = 0; i < n; ++i) {
+        const RenderVertex &a = v[i];
+        const RenderVertex &b = v[(i + 1) % n];
+        double cross = (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+        above |= cross > 0;
+        below |= cross < 0;
+    }
+    return !(above && below);
+}
+
+// Rasterize the highest-detail mesh drawCar() uses for the given type, so the mask follows the part tables
+CarMask buildCarMask(CarType type, double cellW, double cellH) {
+    double w = carWidth;
+    double h = carHeight;
+    const CarMeshView &mesh = carMesh(type, static_cast<int>(LOD_LEVELS.size()) - 1);
+
+    CarMask mask{};
+    mask.firstRow = MASK_ROWS;
+    mask.lastRow = -1;
+    double minX = 1e9, minY = 1e9;
+    double maxX = -1e9, maxY = -1e9;
+
+    for (int r = 0; r < MASK_ROWS; ++r) {
+        double py = MASK_MIN_Y * h + (r + 0.5) * cellH;
+        for (int c = 0; c < MASK_COLS; ++c) {
+            double px = MASK_MIN_X * w + (c + 0.5) * cellW;
+
+            // mesh vertices are in multiples of w / h; scaling both axes keeps polygons convex
+            bool hit = false;
+            for (size_t i = 0; i < mesh.rangeCount && !hit; ++i) {
+                const CarMeshRange &range = mesh.ranges[i];
+                int n = range.prim == RenderPrim::QUADS ? 4 : 3;
+                for (uint32_t v = range.first; v < range.first + range.count && !hit; v += n) {
+                    hit = insideConvex(px / w, py / h, mesh.vertices + v, n);
+                }
+            }
+            if (!hit) continue;
+
+            mask.rows[r] |= uint64_t{1} << c;
+            mask.firstRow = std::min(mask.firstRow, r);
+            mask.lastRow = std::max(mask.lastRow, r);
+            minX = std::min(minX, px - cellW / 2);
+            maxX = std::max(maxX, px + cellW / 2);
+            minY = std::min(minY, py - cellH / 2);
+            maxY = std::max(maxY, py + cellH / 2);
+        }
+    }
+    mask.minX = Coord{minX};
+    mask.maxX = Coord{maxX};
+    mask.minY = Coord{minY};
+    mask.maxY = Coord{maxY};
+    return mask;
+}
+
+// Must be re-run whenever carWidth / carHeight change; rebuilds the meshes the masks are rasterized from first
+void initCarMasks() {
+    rebuildCarMeshes();
+    double cellW = (MASK_MAX_X - MASK_MIN_X) * carWidth / MASK_COLS;
+    double cellH = (MASK_MAX_Y - MASK_MIN_Y) * carHeight / MASK_ROWS;
+    maskCellW = Coord{cellW};
+    maskCellH = Coord{cellH};
+    for (int t = 0; t < CAR_TYPE_COUNT; ++t) {
+        carMasks[t] = buildCarMask(static_cast<CarType>(t), cellW, cellH);
+    }
+}
+
+const CarMask &carMask(CarType type) { return carMasks[static_cast<int>(type)]; }
+
+// Narrowphase: overlap of two masks whose centers are `dx`/`dy` cells apart (b relative to a)
+bool masksOverlap(const CarMask &a, const CarMask &b, int dx, int dy) {
+    if (dx <= -MASK_COLS || dx >= MASK_COLS) return false;
+
+    // row r of a lines up with row r - dy of b
+    int first = std::max(a.firstRow, b.firstRow + dy);
+    int last = std::min(a.lastRow, b.lastRow + dy);
+    for (int r = first; r <= last; ++r) {
+        uint64_t bRow = b.rows[r - dy];
+        uint64_t shifted = dx >= 0 ? bRow << dx : bRow >> -dx;
+        if (a.rows[r] & shifted) return true;
+    }
+    return false;
+}
+
+// #endregion Collision
+
+// #region Bridge
+
+struct Bridge {
+    Coord y;            // Y position of the bridge
+    Coord height;       // Height of the bridge structure
+    Coord shadowOffset; // Offset for shadow effect
+};
+
+// Bridges on screen; one leaves before the next spawns, the rest is headroom for future road features
+const int MAX_BRIDGES = 4;
+using BridgeTable = ArchetypeTable<MAX_BRIDGES, Bridge>;
+BridgeTable bridges;
+const double BRIDGE_HEIGHT = 0.6;
+const double BRIDGE_WIDTH = 2.0; // Spans full window width (left to right)
+int bridgeSpawnIntervalMs = 8000; // Spawn every 8 seconds
+const Coord BRIDGE_SPEED{0.01};            // per tick
+
+void initBridge() {
+    bridges.clear();
+}
+
+RandReal bridgeHeightDist(-0.02, 0.02);
+RandReal bridgeChanceDist(0.0, 1.0);
+
+bool spawnBridge(BridgeTable &bridges, Pcg32 &rng) {
+    // Only spawn once the previous bridge has left
+    if (!bridges.empty()) return false;
+    // distributions are copied because autopilot rollouts run this on worker threads
+    RandReal heightDist = bridgeHeightDist;
+    Coord height{BRIDGE_HEIGHT + heightDist(rng)};          // Slight height variation
+    bridges.create({Coord{1.5}, height, Coord{0.02}}); // Spawn above visible area
+    return true;
+}
+
+void drawBridge(const Bridge &bridge) {
+    double bridgeY = bridge.y;
+    double bridgeLeft = -1.0; // Full screen width from left edge
+    double bridgeRight = 1.0; // Full screen width to right edge
+    double bridgeTop = bridgeY + bridge.height;
+    double bridgeBottom = bridgeY;
+
+    rqLayer(RenderLayer::BRIDGE);
+    rqBeginObject();
+
+    // Draw shadow first (darker, slightly offset)
+    rqColor3d(0.1, 0.1, 0.1);
+    rqBegin(GL_QUADS);
+    rqVertex2d(bridgeLeft + bridge.shadowOffset, bridgeBottom - bridge.shadowOffset);
+    rqVertex2d(bridgeRight + bridge.shadowOffset, bridgeBottom - bridge.shadowOffset);
+    rqVertex2d(bridgeRight + bridge.shadowOffset, bridgeTop - bridge.shadowOffset);
+    rqVertex2d(bridgeLeft + bridge.shadowOffset, bridgeTop - bridge.shadowOffset);
+    rqEnd();
+
+    // Draw main bridge structure (concrete gray) - spans full screen width
+    rqColor3d(0.3, 0.3, 0.3);
+    rqBegin(GL_QUADS);
+    rqVertex2d(bridgeLeft, bridgeBottom);
+    rqVertex2d(bridgeRight, bridgeBottom);
+    rqVertex2d(bridgeRight, bridgeTop);
+    rqVertex2d(bridgeLeft, bridgeTop);
+    rqEnd();
+
+    // Draw bridge railings on top and bottom edges
+    double railingHeight = 0.02;
+
+    // Top railing (front edge)
+    rqColor3d(0.7, 0.7, 0.7);
+    rqBegin(GL_QUADS);
+    rqVertex2d(bridgeLeft, bridgeTop);
+    rqVertex2d(bridgeRight, bridgeTop);
+    rqVertex2d(bridgeRight, bridgeTop + railingHeight);
+    rqVertex2d(bridgeLeft, bridgeTop + railingHeight);
+    rqEnd();
+
+    // Bottom railing (back edge)
+    rqBegin(GL_QUADS);
+    rqVertex2d(bridgeLeft, bridgeBottom - railingHeight);
+    rqVertex2d(bridgeRight, bridgeBottom - railingHeight);
+    rqVertex2d(bridgeRight, bridgeBottom);
+    rqVertex2d(bridgeLeft, bridgeBottom);
+    rqEnd();
+
+    // Draw a single dashed lane marking at the center
+    rqColor3d(1, 1, 0.8);
+    double markingHeight = 0.02; // thickness of the line
+    double dashLength = 0.1;     // length of each dash
+    double dashGap = 0.1;        // gap between dashes
+    double centerY = (bridgeTop + bridgeBottom) / 2.0;
+
+    for (double x = bridgeLeft; x < bridgeRight; x += dashLength + dashGap) {
+        rqBegin(GL_QUADS);
+        rqVertex2d(x, centerY - markingHeight / 2);
+        rqVertex2d(x + dashLength, centerY - markingHeight / 2);
+        rqVertex2d(x + dashLength, centerY + markingHeight / 2);
+        rqVertex2d(x, centerY + markingHeight / 2);
+        rqEnd();
+    }
+
+    rqEndObject();
+}
+
+void drawBridge() {
+    TRACE_FUNCTION();
+    const Bridge *b = bridges.column<Bridge>();
+    for (uint32_t i : visibleBridges) {
+        drawBridge(b[i]);
+    }
+}
+
+// The periodic spawn roll, on any copy of the world; true when a bridge spawned
+bool rollBridgeSpawn(BridgeTable &bridges, Pcg32 &rng) {
+    // Random chance to spawn bridge (70% probability)
+    RandReal chanceDist = bridgeChanceDist;
+    return chanceDist(rng) < 0.7 && spawnBridge(bridges, rng);
+}
+
+// One tick of bridge movement on any copy of the world
+void stepBridge(BridgeTable &bridges) {
+    Bridge *b = bridges.column<Bridge>();
+    for (uint32_t i = static_cast<uint32_t>(bridges.size()); i-- > 0;) {
+        b[i].y -= BRIDGE_SPEED; // Move bridge down with road
+
+        // Remove the bridge once it goes off screen
+        if (b[i].y < -1.5) bridges.destroyRow(i);
+    }
+}
+
+void updateBridge() {
+    TRACE_FUNCTION();
+    if (gameFinished) return;
+    stepBridge(bridges);
+}
+
+// #endregion Bridge
+
+// #region Explosion
+
+const int MAX_EXPLOSION_PARTICLES = 40; // simulated; the LOD level decides how many are drawn
+
+struct Lifetime {
+    double remaining;
+    double initial;
+};
+
+// Live particles only: a particle is destroyed when its lifetime runs out
+using ParticleTable = ArchetypeTable<MAX_EXPLOSION_PARTICLES, Position, Velocity, Tint, Lifetime>;
+
+// One particle flattened into a record, as snapshots store it
+struct Particle {
+    Coord x, y;         // Position
+    double vx, vy;      // Velocity
+    double r, g, b;     // Color
+    double lifetime;    // Remaining lifetime
+    double maxLifetime; // Initial lifetime
+};
+
+struct Explosion {
+    double x, y; // Explosion center
+    ParticleTable particles;
+    bool active;
+    int maxParticles = MAX_EXPLOSION_PARTICLES;
+};
+
+Explosion explosion;
+const double EXPLOSION_DURATION = 1.0; // seconds
+
+void initExplosion() {
+    explosion.active = false;
+    explosion.maxParticles = MAX_EXPLOSION_PARTICLES;
+}
+
+RandReal angleDist(0.0, 2.0 * PI);
+RandReal speedDist(0.1, 0.3);
+RandReal lifetimeDist(0.5, 1.0);
+
+void createExplosion(double x, double y) {
+    TRACE_FUNCTION();
+    explosion.x = x;
+    explosion.y = y;
+    explosion.active = true;
+    explosion.particles.clear();
+
+    // Create particles
+    for (int i = 0; i < explosion.maxParticles; ++i) {
+        double angle = angleDist(gen);
+        double speed = speedDist(gen);
+        Velocity v{cos(angle) * speed, sin(angle) * speed};
+
+        Tint tint;
+        if (i % 3 == 0) {
+            tint = {1.0, 0.0, 0.0}; // Red
+        } else if (i % 3 == 1) {
+            tint = {1.0, 0.5, 0.0}; // Orange
+        } else {
+            tint = {1.0, 1.0, 0.0}; // Yellow
+        }
+
+        double lifetime = lifetimeDist(gen);
+        explosion.particles.create({Coord{x}, Coord{y}}, v, tint, {lifetime, lifetime});
+    }
+}
+
+void updateExplosion() {
+    TRACE_FUNCTION();
+    if (!explosion.active) return;
+
+    ParticleTable &t = explosion.particles;
+    Position *pos = t.column<Position>();
+    Velocity *vel = t.column<Velocity>();
+    Lifetime *life = t.column<Lifetime>();
+    for (uint32_t i = static_cast<uint32_t>(t.size()); i-- > 0;) {
+        // Update position
+        pos[i].x += Coord{vel[i].vx * 0.016}; // Assuming ~60 FPS
+        pos[i].y += Coord{vel[i].vy * 0.016};
+
+        // Apply gravity
+        vel[i].vy -= 0.5 * 0.016;
+
+        // Update lifetime
+        life[i].remaining -= 0.016;
+        if (life[i].remaining <= 0) t.destroyRow(i);
+    }
+
+    // Deactivate explosion when all particles are done
+    if (t.empty()) {
+        explosion.active = false;
+    }
+}
+
+void drawExplosion() {
+    TRACE_FUNCTION();
+    if (!explosion.active) return;
+
+    const ParticleTable &t = explosion.particles;
+    const Position *pos = t.column<Position>();
+    const Tint *tint = t.column<Tint>();
+    const Lifetime *life = t.column<Lifetime>();
+    rqLayer(RenderLayer::PARTICLES);
+    for (uint32_t i : visibleParticles) {
+        const Position &p = pos[i];
+
+        // Fade out over time
+        double alpha = life[i].remaining / life[i].initial;
+        rqColor3d(tint[i].r * alpha, tint[i].g * alpha, tint[i].b * alpha);
+
+        // Draw particle as small square
+        double size = 0.02 * alpha; // Shrink over time
+        rqBegin(GL_QUADS);
+        rqVertex2d(p.x - size, p.y - size);
+        rqVertex2d(p.x + size, p.y - size);
+        rqVertex2d(p.x + size, p.y + size);
+        rqVertex2d(p.x - size, p.y + size);
+        rqEnd();
+    }
+}
+
+// #endregion Explosion
+
+// #region Score
+
+int64_t score = 0;
+
+void updateScore() {
+    TRACE_FUNCTION();
+    if (!gameFinished) {
+        score += 1;
+        telemetry.emit(TelemetryEvent::SCORE_TICK, 0, score);
+    }
+}
+
+// A line of HUD text as drawText() would place it; see the Damage region
+struct HudText {
+    double x, y;
+    int width; // pixels
+    uint64_t hash;
+    std::array<float, 4> color; // GL_CURRENT_COLOR, which glRasterPos2d() latches for the text
+};
+const int MAX_HUD_TEXTS = 32;
+bool measuringHud = false; // drawText() only records into hudTexts
+FixedVector<HudText, MAX_HUD_TEXTS> hudTexts;
+
+void drawText(double x, double y, const char *text) {
+    if (measuringHud) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (const char *c = text; *c != '\0'; ++c) h = (h ^ static_cast<uint8_t>(*c)) * 0x100000001b3ULL;
+        int width = glutBitmapLength(GLUT_BITMAP_HELVETICA_18, reinterpret_cast<const unsigned char *>(text));
+        HudText t{x, y, width, h, {}};
+        glGetFloatv(GL_CURRENT_COLOR, t.color.data());
+        hudTexts.push_back(t);
+        return;
+    }
+    glRasterPos2d(x, y);
+    for (; *text != '\0'; ++text) {
+        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *text);
+    }
+}
+
+void drawScore() {
+    TRACE_FUNCTION();
+    glColor3d(1, 1, 1);
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "Score:%lld", static_cast<long long>(score));
+    drawText(-0.95, 0.9, buf);
+}
+
+void drawTimer() {
+    TRACE_FUNCTION();
+    // the clock stops once the run has ended
+    int elapsedMs = gameOver || gameFinished ? finishTimeMs : simTimeMs() - gameStartTimeMs;
+    int totalSeconds = elapsedMs / 1000;
+    int minutes = totalSeconds / 60;
+    int seconds = totalSeconds % 60;
+
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "Time:%02d:%02d", minutes, seconds);
+
+    glColor3d(1, 1, 1);
+    // place at top-right corner
+    drawText(0.8, 0.9, buf);
+}
+
+// #endregion Score
+
+// #region Results
+
+// Every finished or crashed run is appended to an mmap'd history file. A separate mmap'd leaderboard keeps the
+// top-K scores and finish times as binary heaps, so it loads without touching the history and updates in O(log K).
+struct RunRecord {
+    int64_t score;
+    int32_t durationMs; // finish time for finished runs, time of the crash otherwise
+    uint16_t finished;
+    uint8_t scenery;
+    uint8_t reserved;
+    uint64_t seed;
+    int64_t timestamp; // unix seconds
+};
+static_assert(sizeof(RunRecord) == 32, "run records are fixed-size on disk");
+
+struct HistoryHeader {
+    char magic[4]; // "CRRH"
+    uint32_t recordSize;
+    uint64_t count;
+};
+
+const int LEADERBOARD_K = 10;
+
+struct LeaderboardFile {
+    char magic[4]; // "CRLB"
+    uint32_t capacity;
+    uint32_t scoreCount;
+    uint32_t timeCount;
+    uint64_t historyCount; // history records already folded in
+    std::array<RunRecord, LEADERBOARD_K> scores; // min-heap on score: root is the entry to beat
+    std::array<RunRecord, LEADERBOARD_K> times;  // max-heap on durationMs, finished runs only
+};
+
+const char *const RESULTS_HISTORY_PATH = "results.bin";
+const char *const LEADERBOARD_PATH = "leaderboard.bin";
+const size_t HISTORY_GROW_BYTES = 64 * 1024;
+
+bool higherScore(const RunRecord &a, const RunRecord &b) { return a.score > b.score; }
+bool fasterTime(const RunRecord &a, const RunRecord &b) { return a.durationMs < b.durationMs; }
+
+// Keep the best `capacity` records in a heap whose root is the worst kept record
+template <typename Better>
+void offerTopK(RunRecord *heap, uint32_t &count, uint32_t capacity, const RunRecord &rec, Better better) {
+    if (count < capacity) {
+        heap[count++] = rec;
+        std::push_heap(heap, heap + count, better);
+    } else if (better(rec, heap[0])) {
+        std::pop_heap(heap, heap + count, better);
+        heap[count - 1] = rec;
+        std::push_heap(heap, heap + count, better);
+    }
+}
+
+struct ResultsStore {
+    MappedFile history;
+    MappedFile board;
+
+    ~ResultsStore() {
+        closeMapped(history);
+        closeMapped(board);
+    }
+
+    bool active() const { return history.data != nullptr && board.data != nullptr; }
+    HistoryHeader &historyHeader() { return *reinterpret_cast<HistoryHeader *>(history.data); }
+    LeaderboardFile &leaderboard() { return *reinterpret_cast<LeaderboardFile *>(board.data); }
+    const RunRecord *records() { return reinterpret_cast<const RunRecord *>(history.data + sizeof(HistoryHeader)); }
+
+    bool open(const char *historyPath, const char *boardPath) {
+        if (!openMapped(history, historyPath, true, sizeof(HistoryHeader) + HISTORY_GROW_BYTES) ||
+            !openMapped(board, boardPath, true, sizeof(LeaderboardFile))) {
+            closeMapped(history);
+            closeMapped(board);
+            return false;
+        }
+
+        HistoryHeader &hh = historyHeader();
+        if (std::memcmp(hh.magic, "CRRH", 4) != 0 || hh.recordSize != sizeof(RunRecord)) {
+            hh = {{'C', 'R', 'R', 'H'}, sizeof(RunRecord), 0};
+        }
+        hh.count = std::min<uint64_t>(hh.count, (history.size - sizeof(HistoryHeader)) / sizeof(RunRecord));
+
+        // The leaderboard is trusted as long as it matches and its counts fit its heaps; otherwise it is rebuilt
+        // from the history. Either way, fold in whatever history it is missing.
+        LeaderboardFile &lb = leaderboard();
+        if (std::memcmp(lb.magic, "CRLB", 4) != 0 || lb.capacity != LEADERBOARD_K || lb.historyCount > hh.count ||
+            lb.scoreCount > LEADERBOARD_K || lb.timeCount > LEADERBOARD_K) {
+            lb = LeaderboardFile{{'C', 'R', 'L', 'B'}, LEADERBOARD_K, 0, 0, 0, {}, {}};
+        }
+        for (; lb.historyCount < hh.count; ++lb.historyCount) {
+            rank(records()[lb.historyCount]);
+        }
+        return true;
+    }
+
+    void rank(const RunRecord &rec) {
+        LeaderboardFile &lb = leaderboard();
+        offerTopK(lb.scores.data(), lb.scoreCount, LEADERBOARD_K, rec, higherScore);
+        if (rec.finished) offerTopK(lb.times.data(), lb.timeCount, LEADERBOARD_K, rec, fasterTime);
+    }
+
+    void append(const RunRecord &rec) {
+        if (!active()) return;
+        HistoryHeader *hh = &historyHeader();
+        size_t offset = sizeof(HistoryHeader) + hh->count * sizeof(RunRecord);
+        if (offset + sizeof(RunRecord) > history.size) {
+            if (!resizeMapped(history, history.size + HISTORY_GROW_BYTES)) return;
+            hh = &historyHeader();
+        }
+        std::memcpy(history.data + offset, &rec, sizeof(RunRecord));
+        hh->count += 1;
+
+        rank(rec);
+        leaderboard().historyCount = hh->count;
+    }
+
+    // Leaderboard roots are the worst kept entries, so the best ones need a scan of K records
+    const RunRecord *bestScore() {
+        if (!active() || leaderboard().scoreCount == 0) return nullptr;
+        const auto &lb = leaderboard();
+        return &*std::min_element(lb.scores.begin(), lb.scores.begin() + lb.scoreCount, higherScore);
+    }
+
+    const RunRecord *bestTime() {
+        if (!active() || leaderboard().timeCount == 0) return nullptr;
+        const auto &lb = leaderboard();
+        return &*std::min_element(lb.times.begin(), lb.times.begin() + lb.timeCount, fasterTime);
+    }
+};
+ResultsStore results;
+
+// Freeze the run clock and store the result
+void endRun(bool finished) {
+    finishTimeMs = simTimeMs() - gameStartTimeMs;
+    if (resimulating) return;
+    results.append({score, finishTimeMs, static_cast<uint16_t>(finished), static_cast<uint8_t>(currentScenery), 0,
+                     sessionSeed, static_cast<int64_t>(std::time(nullptr))});
+}
+
+void drawBestResults(double y) {
+    TRACE_FUNCTION();
+    char buf[64];
+    glColor3d(1, 1, 1);
+    if (const RunRecord *best = results.bestScore()) {
+        std::snprintf(buf, sizeof(buf), "High score: %lld", static_cast<long long>(best->score));
+        drawText(-0.4, y, buf);
+    }
+    if (const RunRecord *best = results.bestTime()) {
+        int totalSeconds = best->durationMs / 1000;
+        std::snprintf(buf, sizeof(buf), "Best time: %02d:%02d.%d", totalSeconds / 60, totalSeconds % 60,
+                      best->durationMs % 1000 / 100);
+        drawText(-0.4, y - 0.08, buf);
+    }
+}
+
+// #endregion Results
+
+// #region Stats
+
+// Frame statistics overlay, toggled with F3
+bool showStats = false;
+
+struct FrameStats {
+    double lastFrameMs = 0.0;
+    int framesThisSecond = 0;
+    int fps = 0;
+    std::chrono::steady_clock::time_point secondStart = std::chrono::steady_clock::now();
+
+    void frameFinished(double frameMs) {
+        lastFrameMs = frameMs;
+        ++framesThisSecond;
+        auto now = std::chrono::steady_clock::now();
+        if (now - secondStart >= std::chrono::seconds(1)) {
+            fps = framesThisSecond;
+            framesThisSecond = 0;
+            secondStart = now;
+        }
+    }
+};
+FrameStats frameStats;
+
+void drawStats() {
+    TRACE_FUNCTION();
+    char buf[96];
+    glColor3d(1, 1, 0.3);
+    std::snprintf(buf, sizeof(buf), "FPS %d  frame %.2f ms (avg %.2f / budget %.1f)  LOD %d  res %d%%",
+                  frameStats.fps, frameStats.lastFrameMs, lodController.avgFrameMs, lodController.budgetMs,
+                  lodController.level, static_cast<int>(std::lround(resolution.scale() * 100)));
+    drawText(-0.95, 0.82, buf);
+    std::snprintf(buf, sizeof(buf), "drawn %d  culled %d  commands %d  draw calls %d  color changes %d",
+                  cullStats.drawn, cullStats.culled, rq.stats.commands, rq.stats.drawCalls, rq.stats.colorChanges);
+    drawText(-0.95, 0.75, buf);
+}
+
+// #endregion Stats
+
+// #region Enemy
+
+using EnemyTable = ArchetypeTable<MAX_ENEMIES, Position, Tint, CarType>;
+EnemyTable enemies;
+int enemyCount = 4;
+Coord enemySpeed{0.01}; // per tick
+
+// One enemy flattened into a record, as snapshots store it
+struct EnemyCar {
+    Coord x, y;
+    CarType type;
+    double r, g, b;
+};
+
+const std::array<Tint, 8> ENEMY_PALETTE{{
+    {1.0, 1.0, 1.0},    // White
+    {0.4, 0.4, 0.4},    // Black
+    {0.75, 0.75, 0.75}, // Gray
+    {0.2, 0.2, 0.35},   // Dark Blue
+    {0.8, 0.0, 0.0},    // Red
+    {0.6, 0.0, 0.0},    // Maroon
+    {0.8, 0.6, 0.4},    // Beige
+    {0.0, 0.4, 0.2}     // Dark Green
+}};
+
+// Add a car of random lane, paint and type at height y; false when the table is full
+bool spawnEnemy(double y) {
+    RandInt typeDist(0, CAR_TYPE_COUNT - 1);
+    RandInt colorDist(0, static_cast<int>(ENEMY_PALETTE.size()) - 1);
+    Position pos{lanes[laneDist(gen)], Coord{y}};
+    const Tint &tint = ENEMY_PALETTE[colorDist(gen)];
+    auto type = static_cast<CarType>(typeDist(gen));
+    return enemies.alive(enemies.create(pos, tint, type));
+}
+
+void initEnemies() {
+    // the cars start spread over two screen heights, however many there are
+    enemies.clear();
+    for (int i = 0; i < enemyCount; ++i) {
+        spawnEnemy(1.2 + i * 2.0 / enemyCount);
+    }
+}
+
+// Put every car back in a lane after the lanes changed, keeping it at the same fraction of the road's width
+void moveEnemiesToLanes(double oldRoadWidth) {
+    Position *pos = enemies.column<Position>();
+    int numLanes = static_cast<int>(lanes.size());
+    for (uint32_t e = 0; e < enemies.size(); ++e) {
+        double across = (double(pos[e].x) + oldRoadWidth / 2) / oldRoadWidth;
+        pos[e].x = lanes[std::min(std::max(static_cast<int>(across * numLanes), 0), numLanes - 1)];
+    }
+}
+
+void drawEnemies() {
+    TRACE_FUNCTION();
+    const Position *pos = enemies.column<Position>();
+    const Tint *tint = enemies.column<Tint>();
+    const CarType *type = enemies.column<CarType>();
+    for (uint32_t i : visibleEnemies) {
+        drawCar(pos[i].x, pos[i].y, tint[i].r, tint[i].g, tint[i].b, type[i]);
+    }
+}
+
+bool checkCollision(Coord x1, Coord y1, CarType t1, Coord x2, Coord y2, CarType t2) {
+    if (!isCollisionEnabled) return false;
+
+    // broadphase: tight silhouette bounds
+    const CarMask &a = carMask(t1);
+    const CarMask &b = carMask(t2);
+    if (x1 + a.maxX <= x2 + b.minX || x2 + b.maxX <= x1 + a.minX) return false;
+    if (y1 + a.maxY <= y2 + b.minY || y2 + b.maxY <= y1 + a.minY) return false;
+
+    int dx = roundedSteps(x2 - x1, maskCellW);
+    int dy = roundedSteps(y2 - y1, maskCellH);
+    return masksOverlap(a, b, dx, dy);
+}
+
+// Drive one enemy down the road, respawning it in a random lane once it leaves the screen
+void stepEnemy(Position &enemy, Pcg32 &rng) {
+    enemy.y -= enemySpeed;
+    if (enemy.y < -1.4) {
+        RandInt lane = laneDist; // copied, see spawnBridge()
+        enemy.y = Coord{1.4};
+        enemy.x = lanes[lane(rng)];
+    }
+}
+
+// Per-car result of the parallel pass in updateEnemies()
+struct EnemyStep {
+    Coord y;      // after this tick's move
+    bool respawn; // left the screen; the new lane is drawn in the serial pass
+    uint8_t hits; // bit per player the moved car overlaps
+};
+std::array<EnemyStep, MAX_ENEMIES> enemySteps;
+const uint32_t ENEMY_CHUNK = 256; // cars per parallel job
+
+// Bit per player the car overlaps at (x, y)
+uint8_t enemyHits(Coord x, Coord y, CarType type) {
+    uint8_t hits = 0;
+    for (int i = 0; i < playerCount; ++i) {
+        if (checkCollision(players[i].x, players[i].y, PLAYER_CAR_TYPE, x, y, type)) hits |= 1 << i;
+    }
+    return hits;
+}
+
+void updateEnemies() {
+    TRACE_FUNCTION();
+    if (gameFinished) return; // Stop updating enemies once the game is finished
+
+    // Moving and collision testing are independent per car, so they run in parallel chunks. Respawns draw from the
+    // gameplay RNG, crashes create explosions (more draws) and the run can end part-way through the cars, so the
+    // results are applied in car order afterwards, exactly as a serial loop would have.
+    Position *pos = enemies.column<Position>();
+    const CarType *type = enemies.column<CarType>();
+    jobs.parallelFor(static_cast<uint32_t>(enemies.size()), ENEMY_CHUNK, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t e = begin; e < end; ++e) {
+            EnemyStep &step = enemySteps[e];
+            step.y = pos[e].y - enemySpeed;
+            step.respawn = step.y < -1.4;
+            step.hits = step.respawn ? 0 : enemyHits(pos[e].x, step.y, type[e]);
+        }
+    });
+
+    for (uint32_t e = 0; e < enemies.size(); ++e) {
+        Position &enemy = pos[e];
+        uint8_t hits;
+        if (enemySteps[e].respawn) {
+            stepEnemy(enemy, gen);
+            hits = enemyHits(enemy.x, enemy.y, type[e]);
+        } else {
+            enemy.y = enemySteps[e].y;
+            hits = enemySteps[e].hits;
+        }
+
+        for (int i = 0; i < playerCount; ++i) {
+            Player &player = players[i];
+            if (player.crashed || (hits >> i & 1) == 0) continue;
+            // Create explosion at collision point
+            double explosionX = (double(player.x) + double(enemy.x)) / 2.0;
+            double explosionY = (double(player.y) + double(enemy.y)) / 2.0;
+            createExplosion(explosionX, explosionY);
+            telemetry.emit(TelemetryEvent::COLLISION, static_cast<uint16_t>(type[e]), score, enemy.x, enemy.y);
+            player.crashed = true;
+        }
+
+        // the run ends once every car is out
+        bool anyDriving = std::any_of(players.begin(), players.begin() + playerCount,
+                                      [](const Player &p) { return !p.crashed; });
+        if (!anyDriving) {
+            if (!resimulating) std::cout << "Game Over!!\n";
+            gameOver = true;
+            endRun(false);
+            break;
+        }
+    }
+}
+
+// #endregion Enemy
+
+// #region Race events
+
+// Timed gameplay runs off the timer wheel instead of being polled every tick. Events fire at the start of a
+// running tick, before its update phases, and the wheel only advances while the run is live.
+enum RaceEventType : uint8_t {
+    EVENT_BRIDGE_ROLL,     // periodic bridge spawn roll; reschedules itself
+    EVENT_SCENERY_SWITCH,  // periodic scenery rotation; reschedules itself
+    EVENT_FINISH_LINE,     // finish line comes into view
+    EVENT_BRIDGE,          // bridge now, if the road is clear
+    EVENT_TRAFFIC_WAVE,    // arg cars join above the screen
+};
+
+struct RaceEvent {
+    int atMs; // after the start of the run
+    RaceEventType type;
+    uint16_t arg;
+};
+
+// What happens in a run besides the periodic events
+const std::array<RaceEvent, 4> RACE_SCRIPT{{
+    {20000, EVENT_BRIDGE, 0},
+    {30000, EVENT_TRAFFIC_WAVE, 2},
+    {45000, EVENT_BRIDGE, 0},
+    {FINISH_LINE_AT_MS, EVENT_FINISH_LINE, 0},
+}};
+
+TimerWheel raceTimers;
+TimerHandle bridgeRollTimer; // the rollouts' bridge timing follows this one
+TimerHandle sceneryTimer;
+
+uint32_t msToTicks(int ms) { return static_cast<uint32_t>((ms + TICK_MS - 1) / TICK_MS); }
+
+void scheduleSceneryTimer() {
+    raceTimers.cancel(sceneryTimer);
+    sceneryTimer = raceTimers.schedule(msToTicks(scenerayIntervalMS), EVENT_SCENERY_SWITCH);
+}
+
+// Schedule a new run's events from the current tick on
+void startRaceEvents() {
+    raceTimers.reset(simTick);
+    bridgeRollTimer = raceTimers.schedule(msToTicks(bridgeSpawnIntervalMs), EVENT_BRIDGE_ROLL);
+    sceneryTimer = raceTimers.schedule(msToTicks(scenerayIntervalMS), EVENT_SCENERY_SWITCH);
+    for (const RaceEvent &e : RACE_SCRIPT) {
+        raceTimers.schedule(msToTicks(e.atMs), e.type, e.arg);
+    }
+}
+
+void emitBridgeSpawn() {
+    const Bridge &spawned = bridges.column<Bridge>()[bridges.size() - 1];
+    telemetry.emit(TelemetryEvent::BRIDGE_SPAWN, 0, 0, 0.0, spawned.height);
+}
+
+void fireRaceEvent(uint8_t type, uint16_t arg) {
+    switch (type) {
+    case EVENT_BRIDGE_ROLL:
+        if (rollBridgeSpawn(bridges, gen)) emitBridgeSpawn();
+        bridgeRollTimer = raceTimers.schedule(msToTicks(bridgeSpawnIntervalMs), EVENT_BRIDGE_ROLL);
+        break;
+    case EVENT_SCENERY_SWITCH:
+        switchScenery(static_cast<SceneryType>((static_cast<int>(currentScenery) + 1) % 3));
+        sceneryTimer = raceTimers.schedule(msToTicks(scenerayIntervalMS), EVENT_SCENERY_SWITCH);
+        break;
+    case EVENT_FINISH_LINE:
+        finishLineSpawned = true;
+        finishScroll0 = roadScroll; // remember spawn scroll position
+        break;
+    case EVENT_BRIDGE:
+        if (spawnBridge(bridges, gen)) emitBridgeSpawn();
+        break;
+    case EVENT_TRAFFIC_WAVE:
+        // the wave enters in rows 0.3 apart above the screen
+        for (uint16_t i = 0; i < arg; ++i) {
+            if (!spawnEnemy(1.2 + i * 0.3)) break;
+        }
+        break;
+    }
+}
+
+// #endregion Race events
+
+void resetGame() {
+    telemetry.emit(TelemetryEvent::RESET, 0, score);
+    resetPlayers();
+    gameOver = false;
+    gameFinished = false;
+    score = 0;
+    finishTimeMs = 0;
+    laneOffset = Coord{0.0};
+    initEnemies();
+    // Reset the start time so start/finish lines schedule restarts as well
+    gameStartTimeMs = simTimeMs();
+
+    // Reset non-wrapping scroll anchors so lines don't reappear on laneOffset wrap
+    roadScroll = Coord{0.0};
+    startScroll0 = roadScroll;
+    finishLineSpawned = false;
+    finishScroll0 = Coord{0.0};
+    startRaceEvents();
+}
+
+const std::array<std::array<double, 3>, MAX_PLAYERS> PLAYER_COLORS{{
+    {0.2, 0.3, 0.9}, // Blue
+    {0.9, 0.5, 0.1}, // Orange
+    {0.2, 0.7, 0.3}, // Green
+    {0.7, 0.2, 0.7}, // Purple
+}};
+
+void drawPlayers() {
+    TRACE_FUNCTION();
+    for (int i = 0; i < playerCount; ++i) {
+        const auto &c = PLAYER_COLORS[i];
+        drawCar(players[i].x, players[i].y, c[0], c[1], c[2], PLAYER_CAR_TYPE);
+    }
+}
+
+void drawGameOverOverlay() {
+    TRACE_FUNCTION();
+    drawText(-0.3, 0.05, "GAME OVER");
+    glColor3d(1, 1, 1);
+    drawText(-0.4, -0.05, "Press Enter to Restart");
+    drawBestResults(-0.2);
+}
+
+void drawContratulationsOverlay() {
+    TRACE_FUNCTION();
+    glColor3d(1, 0.2, 0.2);
+    drawText(-0.4, 0.05, "CONGRATULATIONS!");
+    glColor3d(1, 1, 1);
+    drawText(-0.5, -0.05, "Press Enter to Play Again");
+    drawBestResults(-0.2);
+}
+
+// #region Snapshot
+
+// Complete simulation state, copied in and out of the globals. Everything is trivially copyable so a snapshot
+// can be written to disk as-is; the enemy array is last so only the live prefix needs storing. Entity tables are
+// stored as flat records in row order; handles are not simulation state, restoring re-issues them.
+struct Snapshot {
+    uint32_t tick;
+    Pcg32 rng;
+    Pcg32 sceneryRng; // sceneryGen state at the last initScenery()
+    uint32_t sceneryTicks;
+    SceneryType scenery;
+    int gameStartTimeMs;
+    int finishTimeMs;
+    bool gameOver, gameFinished, finishLineSpawned;
+    int64_t score;
+    TimerWheel raceTimers;
+    TimerHandle bridgeRollTimer, sceneryTimer;
+    std::array<Player, MAX_PLAYERS> players;
+    Coord laneOffset, roadScroll, startScroll0, finishScroll0;
+    uint32_t bridgeCount;
+    std::array<Bridge, MAX_BRIDGES> bridges;
+    double explosionX, explosionY;
+    bool explosionActive;
+    uint32_t particleCount;
+    std::array<Particle, MAX_EXPLOSION_PARTICLES> particles;
+    uint32_t enemyCount;
+    std::array<EnemyCar, MAX_ENEMIES> enemies;
+};
+static_assert(sizeof(Snapshot) <= UINT16_MAX, "replay keyframe lengths are 16 bits");
+
+// Number of meaningful bytes at the start of a snapshot
+size_t snapshotSize(const Snapshot &s) { return offsetof(Snapshot, enemies) + s.enemyCount * sizeof(EnemyCar); }
+
+// Whether `length` bytes from disk can be a snapshot prefix: counts fit their arrays and the length matches them
+bool snapshotBytesValid(const uint8_t *data, size_t length) {
+    if (length < offsetof(Snapshot, enemies) || length > sizeof(Snapshot)) return false;
+    auto count = [&](size_t offset) {
+        uint32_t v;
+        std::memcpy(&v, data + offset, sizeof(v));
+        return v;
+    };
+    uint32_t enemyCount = count(offsetof(Snapshot, enemyCount));
+    return count(offsetof(Snapshot, bridgeCount)) <= MAX_BRIDGES &&
+           count(offsetof(Snapshot, particleCount)) <= MAX_EXPLOSION_PARTICLES && enemyCount <= MAX_ENEMIES &&
+           length == offsetof(Snapshot, enemies) + enemyCount * sizeof(EnemyCar);
+}
+
+void captureSnapshot(Snapshot &s) {
+    s = Snapshot{}; // zero padding so equal states compare equal byte-wise
+    s.tick = simTick;
+    s.rng = gen;
+    s.sceneryRng = sceneryInitGen;
+    s.sceneryTicks = sceneryTicks;
+    s.scenery = currentScenery;
+    s.gameStartTimeMs = gameStartTimeMs;
+    s.finishTimeMs = finishTimeMs;
+    s.gameOver = gameOver;
+    s.gameFinished = gameFinished;
+    s.finishLineSpawned = finishLineSpawned;
+    s.score = score;
+    s.raceTimers = raceTimers;
+    s.bridgeRollTimer = bridgeRollTimer;
+    s.sceneryTimer = sceneryTimer;
+    s.players = players;
+    s.laneOffset = laneOffset;
+    s.roadScroll = roadScroll;
+    s.startScroll0 = startScroll0;
+    s.finishScroll0 = finishScroll0;
+    s.bridgeCount = static_cast<uint32_t>(bridges.size());
+    std::copy_n(bridges.column<Bridge>(), bridges.size(), s.bridges.begin());
+    s.explosionX = explosion.x;
+    s.explosionY = explosion.y;
+    s.explosionActive = explosion.active;
+
+    const ParticleTable &pt = explosion.particles;
+    s.particleCount = static_cast<uint32_t>(pt.size());
+    for (uint32_t i = 0; i < s.particleCount; ++i) {
+        const Position &p = pt.column<Position>()[i];
+        const Velocity &v = pt.column<Velocity>()[i];
+        const Tint &c = pt.column<Tint>()[i];
+        const Lifetime &l = pt.column<Lifetime>()[i];
+        s.particles[i] = {p.x, p.y, v.vx, v.vy, c.r, c.g, c.b, l.remaining, l.initial};
+    }
+
+    s.enemyCount = static_cast<uint32_t>(enemies.size());
+    for (uint32_t i = 0; i < s.enemyCount; ++i) {
+        const Position &p = enemies.column<Position>()[i];
+        const Tint &c = enemies.column<Tint>()[i];
+        s.enemies[i] = {p.x, p.y, enemies.column<CarType>()[i], c.r, c.g, c.b};
+    }
+}
+
+// Everything but scenery, which restoreSnapshot() rebuilds
+void restoreSimulation(const Snapshot &s) {
+    simTick = s.tick;
+    gen = s.rng;
+    gameStartTimeMs = s.gameStartTimeMs;
+    finishTimeMs = s.finishTimeMs;
+    gameOver = s.gameOver;
+    gameFinished = s.gameFinished;
+    finishLineSpawned = s.finishLineSpawned;
+    score = s.score;
+    raceTimers = s.raceTimers;
+    bridgeRollTimer = s.bridgeRollTimer;
+    sceneryTimer = s.sceneryTimer;
+    players = s.players;
+    laneOffset = s.laneOffset;
+    roadScroll = s.roadScroll;
+    startScroll0 = s.startScroll0;
+    finishScroll0 = s.finishScroll0;
+    bridges.clear();
+    for (uint32_t i = 0; i < s.bridgeCount; ++i) {
+        bridges.create(s.bridges[i]);
+    }
+    enemies.clear();
+    for (uint32_t i = 0; i < s.enemyCount; ++i) {
+        const EnemyCar &e = s.enemies[i];
+        enemies.create({e.x, e.y}, {e.r, e.g, e.b}, e.type);
+    }
+    explosion.x = s.explosionX;
+    explosion.y = s.explosionY;
+    explosion.active = s.explosionActive;
+    explosion.particles.clear();
+    for (uint32_t i = 0; i < s.particleCount; ++i) {
+        const Particle &p = s.particles[i];
+        explosion.particles.create({p.x, p.y}, {p.vx, p.vy}, {p.r, p.g, p.b}, {p.lifetime, p.maxLifetime});
+    }
+}
+
+void restoreSnapshot(const Snapshot &s) {
+    restoreSimulation(s);
+
+    // rebuild scenery from its generator state, then replay the updates since
+    currentScenery = s.scenery;
+    sceneryGen = s.sceneryRng;
+    initScenery(currentScenery);
+    for (uint32_t i = 0; i < s.sceneryTicks; ++i) {
+        updateScenery();
+    }
+}
+
+// #endregion Snapshot
+
+// #region Tick
+
+// One byte of player input per tick. Key callbacks only set bits; the simulation applies them at the next tick
+// boundary so a run is fully described by its seed and input stream.
+enum InputBits : uint8_t {
+    INPUT_LEFT = 1 << 0,
+    INPUT_RIGHT = 1 << 1,
+    INPUT_UP = 1 << 2,
+    INPUT_DOWN = 1 << 3,
+    INPUT_RESET = 1 << 4,
+    INPUT_SCENERY_SHIFT = 5, // bits 5-6: 0 = keep, 1..3 = switch to SceneryType n - 1
+};
+
+// Input byte of every player for one tick, indexed by player
+using TickInput = std::array<uint8_t, MAX_PLAYERS>;
+
+const Coord PLAYER_SPEED_Y{0.05}; // per tick; sideways a tenth of the margin
+
+void movePlayer(Player &p, uint8_t input) {
+    if ((input & INPUT_LEFT) && p.x > -margin) p.x -= margin / 10;
+    if ((input & INPUT_RIGHT) && p.x < margin) p.x += margin / 10;
+    if ((input & INPUT_UP) && p.y < 1.0) p.y += PLAYER_SPEED_Y;
+    if ((input & INPUT_DOWN) && p.y > -1.0) p.y -= PLAYER_SPEED_Y;
+}
+
+void applyInput(const TickInput &input) {
+    // reset and scenery requests are shared; the lowest player index wins a conflicting scenery switch
+    bool reset = false;
+    int scenery = 0;
+    for (int i = playerCount - 1; i >= 0; --i) {
+        reset |= (input[i] & INPUT_RESET) != 0;
+        int requested = (input[i] >> INPUT_SCENERY_SHIFT) & 3;
+        if (requested != 0) scenery = requested;
+    }
+    if (reset && (gameOver || gameFinished)) resetGame();
+    if (scenery != 0) {
+        switchScenery(static_cast<SceneryType>(scenery - 1));
+        scheduleSceneryTimer(); // a requested switch restarts the rotation
+    }
+
+    for (int i = 0; i < playerCount; ++i) {
+        if (!players[i].crashed) movePlayer(players[i], input[i]);
+    }
+}
+
+void checkFinish() {
+    // Check if the player has crossed the finish line
+    if (finishLineSpawned && roadScroll - finishScroll0 <= -1.6) {
+        if (!resimulating) std::cout << "Congratulations! You finished the race!\n";
+        gameFinished = true;
+        telemetry.emit(TelemetryEvent::FINISH, 0, score);
+        endRun(true);
+    }
+}
+
+// State the tick phases touch, for the tick task graph
+enum SimResource : ResourceMask {
+    RES_SCENERY = 1 << 0, // scenery items and their RNG
+    RES_ROAD = 1 << 1,    // lane and scroll offsets, finish line
+    RES_RNG = 1 << 2,     // gameplay RNG
+    RES_BRIDGES = 1 << 3,
+    RES_ENEMIES = 1 << 4,
+    RES_PLAYERS = 1 << 5,
+    RES_EXPLOSION = 1 << 6,
+    RES_SCORE = 1 << 7,
+    RES_RUN = 1 << 8,       // game over / finished flags, saved results, console
+    RES_TELEMETRY = 1 << 9, // single-producer ring: emitters must not overlap
+};
+
+// The phases of a running tick in their serial order. Scenery and road only touch their own state, so they run
+// alongside the traffic chain, which the shared RNG and telemetry ring keep in order.
+TaskGraph tickGraph;
+
+void buildTickGraph() {
+    tickGraph.add("scenery", updateScenery, 0, RES_SCENERY);
+    tickGraph.add("road", updateRoad, 0, RES_ROAD);
+    tickGraph.add("bridges", updateBridge, RES_RUN, RES_BRIDGES);
+    tickGraph.add("traffic", updateEnemies, RES_SCORE,
+                  RES_RNG | RES_ENEMIES | RES_PLAYERS | RES_EXPLOSION | RES_TELEMETRY | RES_RUN);
+    tickGraph.add("score", updateScore, RES_RUN, RES_SCORE | RES_TELEMETRY);
+    tickGraph.add("finish", checkFinish, RES_ROAD | RES_SCORE, RES_RUN | RES_TELEMETRY);
+}
+
+// Advance the simulation by one tick; no rendering, no wall-clock reads
+void simulateTick(const TickInput &input) {
+    TRACE_FUNCTION();
+    applyInput(input);
+
+    if (!gameOver && !gameFinished) {
+        raceTimers.advance(simTick, fireRaceEvent);
+        if (tickGraph.count == 0) buildTickGraph();
+        tickGraph.run(jobs);
+    }
+
+    updateExplosion();
+    ++simTick;
+}
+
+// #endregion Tick
+
+// #region Input
+
+// Held keys live in a key-state table fed by press and release callbacks (auto-repeat is ignored) and are sampled
+// once per tick. Every event is timestamped so the delay until the frame that shows its effect can be measured.
+using InputClock = std::chrono::steady_clock;
+
+enum InputKey { KEY_LEFT, KEY_RIGHT, KEY_UP, KEY_DOWN, KEY_COUNT };
+const std::array<uint8_t, KEY_COUNT> KEY_INPUT_BITS{INPUT_LEFT, INPUT_RIGHT, INPUT_UP, INPUT_DOWN};
+
+struct KeyState {
+    bool down = false;
+    bool pressedSinceSample = false; // keeps taps shorter than a tick
+    InputClock::time_point lastEvent;
+};
+
+// Input-to-present latency in 0.5 ms buckets up to 250 ms; the last bucket collects everything slower
+struct LatencyHistogram {
+    static constexpr int BUCKETS = 501;
+    static constexpr double BUCKET_MS = 0.5;
+
+    std::array<uint32_t, BUCKETS> counts{};
+    uint32_t samples = 0;
+    double maxMs = 0.0;
+
+    void record(double ms) {
+        int bucket = std::min(BUCKETS - 1, static_cast<int>(ms / BUCKET_MS));
+        ++counts[bucket];
+        ++samples;
+        maxMs = std::max(maxMs, ms);
+    }
+
+    // upper edge of the bucket containing the p-th percentile
+    double percentile(double p) const {
+        if (samples == 0) return 0.0;
+        auto target = static_cast<uint32_t>(std::ceil(p / 100.0 * samples));
+        uint32_t seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen >= target) return std::min((i + 1) * BUCKET_MS, maxMs);
+        }
+        return maxMs;
+    }
+};
+
+struct InputState {
+    std::array<KeyState, KEY_COUNT> keys;
+    uint8_t oneShots = 0; // reset / scenery requests, consumed by the next sample
+
+    // oldest event not yet taken by a tick, and oldest sampled event not yet on screen
+    bool hasUnsampled = false;
+    InputClock::time_point firstUnsampled;
+    bool awaitingPresent = false;
+    InputClock::time_point firstUnpresented;
+
+    LatencyHistogram latency;
+};
+InputState inputState;
+
+void stampInputEvent(InputClock::time_point t) {
+    if (!inputState.hasUnsampled) {
+        inputState.hasUnsampled = true;
+        inputState.firstUnsampled = t;
+    }
+}
+
+void keyEvent(InputKey key, bool down) {
+    auto now = InputClock::now();
+    KeyState &k = inputState.keys[key];
+    if (k.down == down) return;
+    k.down = down;
+    k.pressedSinceSample |= down;
+    k.lastEvent = now;
+    stampInputEvent(now);
+}
+
+void oneShotEvent(uint8_t bits, uint8_t mask) {
+    inputState.oneShots = static_cast<uint8_t>((inputState.oneShots & ~mask) | bits);
+    stampInputEvent(InputClock::now());
+}
+
+// Input byte for the coming tick
+uint8_t sampleInput() {
+    uint8_t bits = inputState.oneShots;
+    inputState.oneShots = 0;
+    for (int i = 0; i < KEY_COUNT; ++i) {
+        KeyState &k = inputState.keys[i];
+        if (k.down || k.pressedSinceSample) bits |= KEY_INPUT_BITS[i];
+        k.pressedSinceSample = false;
+    }
+
+    if (inputState.hasUnsampled) {
+        if (!inputState.awaitingPresent) inputState.firstUnpresented = inputState.firstUnsampled;
+        inputState.awaitingPresent = true;
+        inputState.hasUnsampled = false;
+    }
+    return bits;
+}
+
+// Called once a frame has finished rendering
+void inputPresented() {
+    if (!inputState.awaitingPresent) return;
+    inputState.awaitingPresent = false;
+    auto latency = InputClock::now() - inputState.firstUnpresented;
+    inputState.latency.record(std::chrono::duration<double, std::milli>(latency).count());
+}
+
+void drawLatencyStats(double y) {
+    TRACE_FUNCTION();
+    char buf[96];
+    const LatencyHistogram &h = inputState.latency;
+    std::snprintf(buf, sizeof(buf), "input->present p50 %.1f  p99 %.1f  max %.1f ms  (%u samples)", h.percentile(50),
+                  h.percentile(99), h.maxMs, h.samples);
+    drawText(-0.95, y, buf);
+}
+
+// #endregion Input
+
+// #region Autopilot
+
+// Built-in driver for attract mode, soak tests and as a baseline agent. Every tick it copies the part of the world
+// that decides whether its car survives, plays random continuations forward from each possible action on all
+// workers until the time budget runs out, and takes the action with the best continuation found.
+// Rollouts reuse movePlayer(), rollBridgeSpawn(), stepBridge(), stepEnemy() and checkCollision(), follow the
+// periodic bridge roll on its timer and start from the live gameplay RNG, so they see exactly the traffic the real
+// ticks will produce unless the race script adds some. Scenery has its own RNG stream and never affects traffic, so
+// it is left out.
+const std::array<uint8_t, 5> AUTOPILOT_ACTIONS{0, INPUT_LEFT, INPUT_RIGHT, INPUT_UP, INPUT_DOWN};
+const uint8_t STEERING_INPUTS = INPUT_LEFT | INPUT_RIGHT | INPUT_UP | INPUT_DOWN;
+const int AUTOPILOT_HOLD_TICKS = 8;      // a candidate action is held this long before the random continuation
+const int AUTOPILOT_RESTART_TICKS = 100; // ~3 s on the game over screen before starting a new run
+
+// Gameplay state a rollout advances
+struct RolloutWorld {
+    uint32_t tick;
+    Pcg32 rng;
+    Player player;
+    BridgeTable bridges;
+    uint32_t bridgeRollTick; // next EVENT_BRIDGE_ROLL
+    EnemyTable enemies;
+};
+
+// The live world as seen by one player
+RolloutWorld liveWorld(int player) {
+    return {simTick, gen, players[player], bridges, raceTimers.dueTick(bridgeRollTimer), enemies};
+}
+
+// Ticks survived, mirroring the order of simulateTick(). Surviving the whole horizon scores up to five ticks
+// extra for ending near the start row and the middle of the road: cars parked against an edge get boxed in by
+// traffic further out than the horizon reaches.
+double rollout(RolloutWorld w, uint8_t firstAction, Pcg32 &policy, int depth) {
+    uint8_t action = firstAction;
+    for (int t = 0; t < depth; ++t) {
+        // the continuation holds an action for a few ticks at a time, like a driver would
+        if (t >= AUTOPILOT_HOLD_TICKS && policy() % 4 == 0) {
+            action = AUTOPILOT_ACTIONS[policy() % AUTOPILOT_ACTIONS.size()];
+        }
+        movePlayer(w.player, action);
+        if (w.tick == w.bridgeRollTick) {
+            rollBridgeSpawn(w.bridges, w.rng);
+            w.bridgeRollTick += msToTicks(bridgeSpawnIntervalMs);
+        }
+        stepBridge(w.bridges);
+        Position *pos = w.enemies.column<Position>();
+        const CarType *type = w.enemies.column<CarType>();
+        for (uint32_t e = 0; e < w.enemies.size(); ++e) {
+            stepEnemy(pos[e], w.rng);
+            if (checkCollision(w.player.x, w.player.y, PLAYER_CAR_TYPE, pos[e].x, pos[e].y, type[e])) return t;
+        }
+        ++w.tick;
+    }
+    double room = 1.0 - 0.25 * std::abs(w.player.y - PLAYER_START_Y) - 0.5 * std::abs(w.player.x) / margin;
+    return depth + 5 * std::max(room, 0.0);
+}
+
+// Per-worker totals, on separate cache lines
+struct alignas(64) RolloutTotals {
+    std::array<double, AUTOPILOT_ACTIONS.size()> score;
+    std::array<double, AUTOPILOT_ACTIONS.size()> best; // best single rollout
+    std::array<uint32_t, AUTOPILOT_ACTIONS.size()> rollouts;
+};
+
+struct Autopilot {
+    bool enabled = false;
+    double budgetMs = 5.0; // per tick, shared by all workers
+    int depth = 120;       // ticks looked ahead (~3.6 s)
+    std::vector<RolloutTotals> totals; // one per job system thread
+
+    // job input for the current tick
+    RolloutWorld root{};
+    InputClock::time_point deadline;
+
+    // last decision, for the HUD
+    uint32_t lastRollouts = 0;
+    uint8_t lastAction = 0;
+    int idleTicks = 0;
+
+    void setEnabled(bool on) {
+        if (on && totals.empty()) totals.resize(jobs.size());
+        enabled = on;
+    }
+
+    // One share of the rollouts; share 0 is the caller's
+    static void work(Autopilot &ap, uint32_t worker) {
+        RolloutTotals &out = ap.totals[worker];
+        out = {};
+        Pcg32 policy;
+        policy.seed(ap.root.tick, static_cast<uint64_t>(worker) + 100);
+
+        // the caller always evaluates every action once, even with the budget already spent
+        uint32_t minimum = worker == 0 ? AUTOPILOT_ACTIONS.size() : 0;
+        for (uint32_t n = 0; n < minimum || InputClock::now() < ap.deadline; ++n) {
+            size_t a = (n + worker) % AUTOPILOT_ACTIONS.size();
+            double score = rollout(ap.root, AUTOPILOT_ACTIONS[a], policy, ap.depth);
+            out.score[a] += score;
+            out.best[a] = std::max(out.best[a], score);
+            ++out.rollouts[a];
+        }
+    }
+
+    uint8_t decide(int player) {
+        if (gameOver || gameFinished) return ++idleTicks >= AUTOPILOT_RESTART_TICKS ? INPUT_RESET : 0;
+        idleTicks = 0;
+        if (players[player].crashed) return 0;
+
+        root = liveWorld(player);
+        deadline = InputClock::now() + std::chrono::microseconds(static_cast<int64_t>(budgetMs * 1000));
+        jobs.parallelFor(static_cast<uint32_t>(totals.size()), 1, [this](uint32_t begin, uint32_t end) {
+            for (uint32_t w = begin; w < end; ++w) work(*this, w);
+        });
+
+        // An action is as good as the best continuation found after it; the mean breaks ties in favour of actions
+        // with more ways out. Remaining ties keep the earlier action, so a safe car holds still.
+        size_t best = 0;
+        double bestValue = -1.0;
+        lastRollouts = 0;
+        for (size_t a = 0; a < AUTOPILOT_ACTIONS.size(); ++a) {
+            double score = 0.0;
+            double top = 0.0;
+            uint32_t rollouts = 0;
+            for (const RolloutTotals &t : totals) {
+                score += t.score[a];
+                top = std::max(top, t.best[a]);
+                rollouts += t.rollouts[a];
+            }
+            lastRollouts += rollouts;
+            double mean = rollouts > 0 ? score / rollouts : 0.0;
+            double value = top + mean / (depth + 2);
+            if (value > bestValue) {
+                bestValue = value;
+                best = a;
+            }
+        }
+        lastAction = AUTOPILOT_ACTIONS[best];
+        return lastAction;
+    }
+};
+Autopilot autopilot;
+
+// Input byte for the local player's coming tick: the keyboard, with steering taken over while the autopilot drives
+uint8_t localInput(int player) {
+    uint8_t bits = sampleInput();
+    if (!autopilot.enabled) return bits;
+    return static_cast<uint8_t>((bits & ~STEERING_INPUTS) | autopilot.decide(player));
+}
+
+void drawAutopilotStatus(double y) {
+    TRACE_FUNCTION();
+    char buf[96];
+    glColor3d(1, 1, 0.3);
+    drawText(0.45, 0.9, "AUTOPILOT");
+    if (y > -1.0) {
+        std::snprintf(buf, sizeof(buf), "autopilot %u rollouts/tick on %d threads, %.1f ms budget, depth %d",
+                      autopilot.lastRollouts, jobs.size(), autopilot.budgetMs, autopilot.depth);
+        drawText(-0.95, y, buf);
+    }
+}
+
+// #endregion Autopilot
+
+// #region Observation
+
+// Renderer-free view of the road for agents and analytics: a world rasterized straight from simulation state into
+// bit planes of rows x cols cells over the screen, one uint64_t per row like the collision masks. Row 0 is the
+// bottom of the screen and bit 0 its left edge. Every shape is a rectangle, so a fill ORs one precomputed column
+// mask into each covered row, 64 cells per operation, and a whole observation takes a few microseconds.
+enum ObservationPlane { OBS_OFFROAD, OBS_PLAYER, OBS_ENEMIES, OBS_BRIDGES, OBS_PLANES };
+const int MAX_OBS_ROWS = 64;
+const int MAX_OBS_COLS = 64;
+
+struct ObservationSpec {
+    int cols = 16; // up to MAX_OBS_COLS
+    int rows = 24; // up to MAX_OBS_ROWS
+};
+
+struct Observation {
+    std::array<std::array<uint64_t, MAX_OBS_ROWS>, OBS_PLANES> planes;
+
+    bool occupied(ObservationPlane plane, int col, int row) const { return planes[plane][row] >> col & 1; }
+};
+
+// Cells [first, last] of an axis of n cells over [-1, 1] that [lo, hi] touches; empty when first > last
+struct CellSpan {
+    int first, last;
+};
+
+CellSpan cellSpan(double lo, double hi, int n) {
+    double scale = 0.5 * n;
+    int first = static_cast<int>(std::floor((std::clamp(lo, -1.0, 1.0) + 1.0) * scale));
+    int last = static_cast<int>(std::ceil((std::clamp(hi, -1.0, 1.0) + 1.0) * scale)) - 1;
+    return {std::max(first, 0), std::min(last, n - 1)};
+}
+
+void fillCells(Observation &obs, ObservationPlane plane, const ObservationSpec &spec, double x0, double y0,
+               double x1, double y1) {
+    CellSpan cols = cellSpan(x0, x1, spec.cols);
+    CellSpan rows = cellSpan(y0, y1, spec.rows);
+    if (cols.first > cols.last || rows.first > rows.last) return;
+    uint64_t mask = (~uint64_t{0} << cols.first) & (~uint64_t{0} >> (63 - cols.last));
+    uint64_t *row = obs.planes[plane].data();
+    for (int r = rows.first; r <= rows.last; ++r) {
+        row[r] |= mask;
+    }
+}
+
+void fillCar(Observation &obs, ObservationPlane plane, const ObservationSpec &spec, double x, double y,
+             CarType type) {
+    const CarMask &m = carMask(type);
+    fillCells(obs, plane, spec, x + m.minX, y + m.minY, x + m.maxX, y + m.maxY);
+}
+
+void encodeObservation(const RolloutWorld &w, const ObservationSpec &spec, Observation &obs) {
+    for (auto &plane : obs.planes) {
+        std::fill_n(plane.begin(), spec.rows, 0);
+    }
+    fillCells(obs, OBS_OFFROAD, spec, -1.0, -1.0, -roadWidth / 2, 1.0);
+    fillCells(obs, OBS_OFFROAD, spec, roadWidth / 2, -1.0, 1.0, 1.0);
+    fillCar(obs, OBS_PLAYER, spec, w.player.x, w.player.y, PLAYER_CAR_TYPE);
+
+    const Position *pos = w.enemies.column<Position>();
+    const CarType *type = w.enemies.column<CarType>();
+    for (uint32_t e = 0; e < w.enemies.size(); ++e) {
+        fillCar(obs, OBS_ENEMIES, spec, pos[e].x, pos[e].y, type[e]);
+    }
+
+    const Bridge *b = w.bridges.column<Bridge>();
+    for (uint32_t i = 0; i < w.bridges.size(); ++i) {
+        fillCells(obs, OBS_BRIDGES, spec, -1.0, b[i].y, 1.0, b[i].y + b[i].height);
+    }
+}
+
+// One observation per world, spread over the job system
+void encodeObservations(const RolloutWorld *worlds, uint32_t count, const ObservationSpec &spec, Observation *out) {
+    const uint32_t grain = 16;
+    jobs.parallelFor(count, grain, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            encodeObservation(worlds[i], spec, out[i]);
+        }
+    });
+}
+
+// Stats overlay: a player's observation as a minimap, with the time it took to encode
+void drawObservation(int player, double left, double top) {
+    TRACE_FUNCTION();
+    static Observation obs;
+    ObservationSpec spec;
+    RolloutWorld world = liveWorld(player);
+    auto start = std::chrono::steady_clock::now();
+    encodeObservation(world, spec, obs);
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    const std::array<std::array<double, 3>, OBS_PLANES> colors{{
+        {0.15, 0.35, 0.15}, // off road
+        {0.2, 0.3, 0.9},    // player
+        {0.9, 0.2, 0.2},    // enemies
+        {0.6, 0.6, 0.6},    // bridges
+    }};
+    double cell = 0.015;
+    glBegin(GL_QUADS);
+    for (int r = 0; r < spec.rows; ++r) {
+        for (int c = 0; c < spec.cols; ++c) {
+            // later planes are drawn over earlier ones
+            int plane = OBS_PLANES - 1;
+            while (plane >= 0 && !obs.occupied(static_cast<ObservationPlane>(plane), c, r)) --plane;
+            if (plane < 0) continue;
+            glColor3d(colors[plane][0], colors[plane][1], colors[plane][2]);
+            double x = left + c * cell;
+            double y = top - (spec.rows - r) * cell;
+            glVertex2d(x, y);
+            glVertex2d(x + cell, y);
+            glVertex2d(x + cell, y + cell);
+            glVertex2d(x, y + cell);
+        }
+    }
+    glEnd();
+
+    char buf[48];
+    std::snprintf(buf, sizeof(buf), "obs %dx%d %.1f us", spec.cols, spec.rows, us);
+    glColor3d(1, 1, 0.3);
+    drawText(left, top - spec.rows * cell - 0.05, buf);
+}
+
+// #endregion Observation
+
+// #region Tuning
+
+// Gameplay parameters that can change while the game runs. The game maps params.bin, writing the built-in values
+// when it is missing or from another build, and `carrace --params [name=value ...]` maps the same file from another
+// process to show or change them. The block is a seqlock: a writer makes the sequence odd, stores, and makes it even
+// again; the game copies the values once per tick and keeps the copy only if the sequence was even and unchanged
+// around it. Derived state (lanes, margin, collision masks) is rebuilt only when a value actually changed.
+// Netplay ignores the block, since every peer must simulate the same rules. A replay records the values in effect
+// when it starts and every change after, and playback applies those instead of the block.
+const char *const TUNING_PATH = "params.bin";
+
+struct TuningValues {
+    double roadWidth;
+    double carWidth;
+    double carHeight;
+    double enemySpeed; // per tick
+    int32_t bridgeSpawnIntervalMs;
+    int32_t sceneryIntervalMs;
+    int32_t explosionParticles;
+    int32_t tickPeriodMs; // wall-clock time between ticks; the simulation still advances TICK_MS per tick
+};
+
+struct TuningBlock {
+    char magic[4];    // "CRPM"
+    uint32_t layout;  // sizeof(TuningValues), so blocks from other builds are replaced
+    std::atomic<uint32_t> sequence; // odd while a writer is storing; counts changes
+    uint32_t reserved;
+    TuningValues values;
+};
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "the sequence is shared between processes");
+
+// Name, place and accepted range of every value, for the CLI and to clamp whatever the game reads
+struct TuningField {
+    const char *name;
+    size_t offset;
+    bool integer;
+    double min, max;
+};
+const std::array<TuningField, 8> TUNING_FIELDS{{
+    {"roadWidth", offsetof(TuningValues, roadWidth), false, 0.2, 2.0},
+    {"carWidth", offsetof(TuningValues, carWidth), false, 0.02, 0.5},
+    {"carHeight", offsetof(TuningValues, carHeight), false, 0.02, 0.5},
+    {"enemySpeed", offsetof(TuningValues, enemySpeed), false, 0.0, 0.1},
+    {"bridgeSpawnIntervalMs", offsetof(TuningValues, bridgeSpawnIntervalMs), true, TICK_MS, 600000},
+    {"sceneryIntervalMs", offsetof(TuningValues, sceneryIntervalMs), true, TICK_MS, 600000},
+    {"explosionParticles", offsetof(TuningValues, explosionParticles), true, 0, MAX_EXPLOSION_PARTICLES},
+    {"tickPeriodMs", offsetof(TuningValues, tickPeriodMs), true, 1, 1000},
+}};
+
+double tuningValue(const TuningValues &v, const TuningField &f) {
+    const auto *p = reinterpret_cast<const uint8_t *>(&v) + f.offset;
+    if (f.integer) return *reinterpret_cast<const int32_t *>(p);
+    return *reinterpret_cast<const double *>(p);
+}
+
+void setTuningValue(TuningValues &v, const TuningField &f, double value) {
+    value = std::isnan(value) ? f.min : std::min(std::max(value, f.min), f.max);
+    auto *p = reinterpret_cast<uint8_t *>(&v) + f.offset;
+    if (f.integer) {
+        *reinterpret_cast<int32_t *>(p) = static_cast<int32_t>(std::lround(value));
+    } else {
+        *reinterpret_cast<double *>(p) = value;
+    }
+}
+
+int tickPeriodMs = TICK_MS;
+
+// The values in effect
+TuningValues currentTuning() {
+    return {roadWidth, carWidth, carHeight, enemySpeed, bridgeSpawnIntervalMs, scenerayIntervalMS,
+            explosion.maxParticles, tickPeriodMs};
+}
+
+// Open (or create) the block; a missing or foreign block is filled with the values in effect
+bool openTuning(MappedFile &file, const char *path) {
+    if (!openMapped(file, path, true, sizeof(TuningBlock))) return false;
+    auto &block = *reinterpret_cast<TuningBlock *>(file.data);
+    if (std::memcmp(block.magic, "CRPM", 4) != 0 || block.layout != sizeof(TuningValues)) {
+        std::memcpy(block.magic, "CRPM", 4);
+        block.layout = sizeof(TuningValues);
+        block.sequence.store(0, std::memory_order_relaxed);
+        block.values = currentTuning();
+    }
+    return true;
+}
+
+struct Tuning {
+    MappedFile file;
+    uint32_t seen = UINT32_MAX; // sequence of the last values applied
+
+    ~Tuning() { closeMapped(file); }
+
+    bool open(const char *path) { return openTuning(file, path); }
+
+    // A consistent copy of the block if it changed since the last call; a writer caught mid-update is retried
+    // next tick
+    bool poll(TuningValues &out) {
+        if (file.data == nullptr) return false;
+        auto &block = *reinterpret_cast<TuningBlock *>(file.data);
+        uint32_t before = block.sequence.load(std::memory_order_acquire);
+        if (before == seen || (before & 1) != 0) return false;
+        std::memcpy(&out, &block.values, sizeof(out));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (block.sequence.load(std::memory_order_relaxed) != before) return false;
+        seen = before;
+        return true;
+    }
+};
+Tuning tuning;
+
+// Clamp `v` and put it in effect, rebuilding what hangs off the geometry: lanes, margin and masks, the cars on the
+// road and the scenery beside it. False when only the pacing changed, which the simulation never sees.
+bool applyTuning(TuningValues v) {
+    for (const TuningField &f : TUNING_FIELDS) {
+        setTuningValue(v, f, tuningValue(v, f));
+    }
+    TuningValues was = currentTuning();
+    tickPeriodMs = v.tickPeriodMs;
+    was.tickPeriodMs = v.tickPeriodMs;
+    if (std::memcmp(&was, &v, sizeof(v)) == 0) return false; // pacing only
+
+    roadWidth = v.roadWidth;
+    carWidth = std::min(v.carWidth, v.roadWidth); // at least one lane
+    carHeight = v.carHeight;
+    enemySpeed = Coord{v.enemySpeed};
+    bridgeSpawnIntervalMs = v.bridgeSpawnIntervalMs;
+    scenerayIntervalMS = v.sceneryIntervalMs;
+    explosion.maxParticles = v.explosionParticles;
+    if (v.roadWidth != was.roadWidth || v.carWidth != was.carWidth || v.carHeight != was.carHeight) {
+        margin = Coord{(roadWidth - carWidth) / 2};
+        initRoad();
+        initCarMasks();
+        moveEnemiesToLanes(was.roadWidth);
+        for (int i = 0; i < playerCount; ++i) {
+            players[i].x = std::min(std::max(players[i].x, -margin), margin);
+        }
+        initScenery(currentScenery);
+    }
+    return true;
+}
+
+// Apply the block's values once per tick, before the simulation runs. True when the simulation changed, which a
+// replay being recorded has to log.
+bool pollTuning() {
+    TuningValues v;
+    return tuning.poll(v) && applyTuning(v);
+}
+
+// `--params` lists the block, `--params name=value ...` changes it
+int tuneParameters(int argc, char **argv) {
+    MappedFile file;
+    if (!openTuning(file, TUNING_PATH)) {
+        std::cerr << "cannot map " << TUNING_PATH << "\n";
+        return 1;
+    }
+    auto &block = *reinterpret_cast<TuningBlock *>(file.data);
+    int status = 0;
+    if (argc > 0) {
+        // take the writer side: even -> odd; two CLIs never store at once
+        uint32_t seq = block.sequence.load(std::memory_order_relaxed);
+        while ((seq & 1) != 0 || !block.sequence.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire)) {
+            if ((seq & 1) != 0) {
+                std::this_thread::yield();
+                seq = block.sequence.load(std::memory_order_relaxed);
+            }
+        }
+        TuningValues v = block.values;
+        for (int i = 0; i < argc; ++i) {
+            const char *eq = std::strchr(argv[i], '=');
+            auto field = std::find_if(TUNING_FIELDS.begin(), TUNING_FIELDS.end(), [&](const TuningField &f) {
+                return eq != nullptr && std::strncmp(f.name, argv[i], eq - argv[i]) == 0 &&
+                       f.name[eq - argv[i]] == '\0';
+            });
+            char *end = nullptr;
+            double value = eq != nullptr ? std::strtod(eq + 1, &end) : 0.0;
+            if (field == TUNING_FIELDS.end() || end == eq + 1 || *end != '\0') {
+                std::cerr << "ignored " << argv[i] << ": expected name=number with a name listed by --params\n";
+                status = 1;
+                continue;
+            }
+            setTuningValue(v, *field, value);
+        }
+        block.values = v;
+        block.sequence.store(seq + 2, std::memory_order_release);
+    }
+    for (const TuningField &f : TUNING_FIELDS) {
+        std::printf("%-22s %g  [%g, %g]\n", f.name, tuningValue(block.values, f), f.min, f.max);
+    }
+    closeMapped(file);
+    return status;
+}
+
+// #endregion Tuning
+
+// #region Replay
+
+// File layout:
+//   ReplayHeader
+//   entry stream: varint((tickDelta << 2) | kind) followed by
+//     kind 0: one byte, the new input XOR the previous one
+//     kind 1: varint(length) + keyframe (Snapshot prefix), taken before the input of that tick is applied
+//     kind 2: TuningValues put in effect before that tick
+//   ReplayIndexEntry[count] (one per keyframe)
+//   ReplayFooter
+// Ticks without an entry repeat the previous input, so idle stretches cost nothing.
+struct ReplayHeader {
+    char magic[4]; // "CRRP"
+    uint16_t version;
+    uint16_t tickMs;
+    uint32_t keyframeInterval;
+    uint32_t snapshotSize; // sizeof(Snapshot) of the writing build
+    uint64_t seed;
+    TuningValues tuning; // in effect at the start
+};
+
+struct ReplayIndexEntry {
+    uint64_t offset;       // keyframe bytes
+    uint64_t tuningOffset; // TuningValues in effect at the keyframe: the header's or the last kind 2 entry's
+    uint32_t tick;
+    uint16_t length;
+    uint8_t prevInput; // input in effect before the keyframe's tick
+    uint8_t reserved;
+};
+
+struct ReplayFooter {
+    uint64_t indexOffset;
+    uint32_t indexCount;
+    uint32_t totalTicks;
+    char magic[4]; // "CRRF"
+    uint32_t reserved;
+};
+
+const char *const REPLAY_RECORD_PATH = "replay.crr";
+const uint16_t REPLAY_VERSION = 3;             // bumped when the same inputs simulate differently
+const uint32_t REPLAY_KEYFRAME_INTERVAL = 300; // ~9 seconds of play
+const uint32_t REPLAY_RESERVE_TICKS = 10 * 3600 * 1000 / TICK_MS; // recording buffers are sized for ten hours
+
+void putVarint(std::vector<uint8_t> &out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+uint64_t getVarint(const uint8_t *data, size_t &pos, size_t end) {
+    uint64_t v = 0;
+    for (int shift = 0; pos < end && shift < 64; shift += 7) {
+        uint8_t b = data[pos++];
+        v |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) break;
+    }
+    return v;
+}
+
+struct ReplayRecorder {
+    bool active = false;
+    std::vector<uint8_t> stream;
+    std::vector<ReplayIndexEntry> index;
+    uint32_t lastEntryTick = 0;
+    uint8_t lastInput = 0;
+    TuningValues tuning{};  // in effect at the start
+    uint64_t tuningOffset = offsetof(ReplayHeader, tuning);
+
+    ~ReplayRecorder() { save(REPLAY_RECORD_PATH); }
+
+    void start() {
+        active = true;
+        stream.clear();
+        index.clear();
+        // ten hours of play never reallocate mid-run: a keyframe of the current world (plus its tag and length)
+        // every interval, and the worst case of an input change (tag and bits, two bytes) on every tick
+        size_t keyframes = REPLAY_RESERVE_TICKS / REPLAY_KEYFRAME_INTERVAL + 1;
+        size_t keyframeBytes = offsetof(Snapshot, enemies) + enemies.size() * sizeof(EnemyCar) + 16;
+        stream.reserve(keyframes * keyframeBytes + 2 * static_cast<size_t>(REPLAY_RESERVE_TICKS));
+        index.reserve(keyframes);
+        lastEntryTick = simTick;
+        lastInput = 0;
+        tuning = currentTuning();
+        tuningOffset = offsetof(ReplayHeader, tuning);
+    }
+
+    void putTag(uint32_t tick, int kind) {
+        putVarint(stream, (static_cast<uint64_t>(tick - lastEntryTick) << 2) | kind);
+        lastEntryTick = tick;
+    }
+
+    // Call once per tick, before simulateTick(input)
+    void recordTick(uint8_t input) {
+        if (!active) return;
+
+        if (simTick % REPLAY_KEYFRAME_INTERVAL == 0) {
+            Snapshot snap;
+            captureSnapshot(snap);
+            size_t len = snapshotSize(snap);
+            putTag(simTick, 1);
+            putVarint(stream, len);
+            index.push_back({sizeof(ReplayHeader) + stream.size(), tuningOffset, simTick, static_cast<uint16_t>(len),
+                             lastInput, 0});
+            const auto *bytes = reinterpret_cast<const uint8_t *>(&snap);
+            stream.insert(stream.end(), bytes, bytes + len);
+        }
+
+        if (input != lastInput) {
+            putTag(simTick, 0);
+            stream.push_back(input ^ lastInput);
+            lastInput = input;
+        }
+    }
+
+    // Call when the parameters changed, before recordTick() of the tick they first apply to
+    void recordTuning() {
+        if (!active) return;
+        TuningValues v = currentTuning();
+        putTag(simTick, 2);
+        tuningOffset = sizeof(ReplayHeader) + stream.size();
+        const auto *bytes = reinterpret_cast<const uint8_t *>(&v);
+        stream.insert(stream.end(), bytes, bytes + sizeof(v));
+    }
+
+    void save(const char *path) {
+        if (!active || index.empty()) return;
+        FILE *f = std::fopen(path, "wb");
+        if (f == nullptr) return;
+
+        ReplayHeader hdr{{'C', 'R', 'R', 'P'}, REPLAY_VERSION, TICK_MS, REPLAY_KEYFRAME_INTERVAL,
+                         sizeof(Snapshot), sessionSeed, tuning};
+        ReplayFooter footer{sizeof(ReplayHeader) + stream.size(), static_cast<uint32_t>(index.size()), simTick,
+                            {'C', 'R', 'R', 'F'}, 0};
+        std::fwrite(&hdr, sizeof(hdr), 1, f);
+        std::fwrite(stream.data(), 1, stream.size(), f);
+        std::fwrite(index.data(), sizeof(ReplayIndexEntry), index.size(), f);
+        std::fwrite(&footer, sizeof(footer), 1, f);
+        std::fclose(f);
+    }
+};
+ReplayRecorder replayRecorder;
+
+struct ReplayPlayer {
+    bool active = false;
+    MappedFile file;
+    const ReplayHeader *header = nullptr;
+    const ReplayIndexEntry *index = nullptr;
+    const ReplayFooter *footer = nullptr;
+
+    // decode cursor
+    size_t pos = 0;
+    size_t end = 0;
+    uint32_t lastEntryTick = 0;
+    uint32_t nextEntryTick = 0;
+    int nextKind = -1; // -1 = stream exhausted
+    uint8_t input = 0;
+
+    bool open(const char *path) {
+        if (!openMapped(file, path, false)) return false;
+        if (!readLayout()) {
+            closeMapped(file);
+            header = nullptr;
+            index = nullptr;
+            footer = nullptr;
+            return false;
+        }
+        end = footer->indexOffset;
+        active = true;
+        return true;
+    }
+
+    // Point header, footer and index into the file, checking everything seek() and nextInput() rely on, so a
+    // truncated or corrupt file is rejected instead of read out of bounds
+    bool readLayout() {
+        if (file.size < sizeof(ReplayHeader) + sizeof(ReplayFooter)) return false;
+        header = reinterpret_cast<const ReplayHeader *>(file.data);
+        footer = reinterpret_cast<const ReplayFooter *>(file.data + file.size - sizeof(ReplayFooter));
+        if (std::memcmp(header->magic, "CRRP", 4) != 0 || std::memcmp(footer->magic, "CRRF", 4) != 0 ||
+            header->version != REPLAY_VERSION || header->snapshotSize != sizeof(Snapshot) ||
+            header->tickMs != TICK_MS || footer->indexCount == 0) {
+            return false;
+        }
+
+        // the index sits exactly between the input stream and the footer
+        size_t indexEnd = file.size - sizeof(ReplayFooter);
+        if (footer->indexOffset < sizeof(ReplayHeader) || footer->indexOffset > indexEnd ||
+            (indexEnd - footer->indexOffset) / sizeof(ReplayIndexEntry) != footer->indexCount ||
+            (indexEnd - footer->indexOffset) % sizeof(ReplayIndexEntry) != 0) {
+            return false;
+        }
+        index = reinterpret_cast<const ReplayIndexEntry *>(file.data + footer->indexOffset);
+
+        // keyframes inside the stream, each a well-formed snapshot, in tick order and at most an interval apart up
+        // to the end, so a seek never resimulates more than one interval
+        for (uint32_t i = 0; i < footer->indexCount; ++i) {
+            const ReplayIndexEntry &e = index[i];
+            uint32_t nextTick = i + 1 < footer->indexCount ? index[i + 1].tick : footer->totalTicks;
+            bool tuningInHeader = e.tuningOffset == offsetof(ReplayHeader, tuning);
+            if (e.offset < sizeof(ReplayHeader) || e.offset > footer->indexOffset ||
+                e.length > footer->indexOffset - e.offset || nextTick < e.tick ||
+                (!tuningInHeader && (e.tuningOffset < sizeof(ReplayHeader) || e.tuningOffset > e.offset ||
+                                     e.offset - e.tuningOffset < sizeof(TuningValues))) ||
+                nextTick - e.tick > REPLAY_KEYFRAME_INTERVAL || !snapshotBytesValid(file.data + e.offset, e.length)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint32_t totalTicks() const { return footer->totalTicks; }
+    bool finished() const { return simTick >= footer->totalTicks; }
+
+    void readTag() {
+        if (pos >= end) {
+            nextKind = -1;
+            return;
+        }
+        uint64_t tag = getVarint(file.data, pos, end);
+        nextEntryTick = lastEntryTick + static_cast<uint32_t>(tag >> 2);
+        nextKind = static_cast<int>(tag & 3);
+        lastEntryTick = nextEntryTick;
+        if (nextKind == 3 || (nextKind == 2 && end - pos < sizeof(TuningValues))) nextKind = -1;
+    }
+
+    void applyTuningAt(uint64_t offset) {
+        TuningValues v;
+        std::memcpy(&v, file.data + offset, sizeof(v));
+        applyTuning(v);
+    }
+
+    // Input for the current tick, consuming the entries that belong to it
+    uint8_t nextInput() {
+        while (nextKind >= 0 && nextEntryTick == simTick) {
+            if (nextKind == 0) {
+                input ^= file.data[pos++];
+            } else if (nextKind == 2) {
+                applyTuningAt(pos);
+                pos += sizeof(TuningValues);
+            } else {
+                pos += getVarint(file.data, pos, end); // already in sync, skip the keyframe
+            }
+            readTag();
+        }
+        return input;
+    }
+
+    // Restore the nearest keyframe at or before `tick`, then simulate forward (at most one keyframe interval)
+    void seek(uint32_t tick) {
+        tick = std::min(tick, totalTicks());
+        const ReplayIndexEntry *first = index;
+        const ReplayIndexEntry *last = index + footer->indexCount;
+        const ReplayIndexEntry *kf =
+            std::upper_bound(first, last, tick, [](uint32_t t, const ReplayIndexEntry &e) { return t < e.tick; });
+        kf = kf == first ? first : kf - 1;
+
+        // the parameters first, so the world they rebuild is then overwritten by the keyframe's
+        applyTuningAt(kf->tuningOffset);
+        Snapshot snap{};
+        std::memcpy(&snap, file.data + kf->offset, std::min<size_t>(kf->length, sizeof(Snapshot)));
+        restoreSnapshot(snap);
+
+        pos = kf->offset + kf->length;
+        lastEntryTick = kf->tick;
+        input = kf->prevInput;
+        readTag();
+
+        resimulating = true;
+        while (simTick < tick) {
+            simulateTick({nextInput()});
+        }
+        resimulating = false;
+    }
+};
+ReplayPlayer replayPlayer;
+
+// #endregion Replay
+
+// #region Net
+
+// Rollback netplay. Every instance simulates every car from the same seed and exchanges only input bytes over
+// UDP. Local input is applied at once; a remote input that has not arrived is predicted by repeating that
+// player's last known input. When a real input differs from its prediction the world is restored to the
+// snapshot taken at that tick and the ticks since are simulated again. Once every player's input for a tick is
+// known, that tick's state is final and its hash is exchanged to catch desyncs.
+const uint32_t NET_ROLLBACK_TICKS = 32; // snapshot history; the local sim stalls rather than outrun it
+const uint32_t NET_INPUT_TICKS = 2 * NET_ROLLBACK_TICKS;
+const uint16_t NET_DEFAULT_PORT = 47800;
+
+struct NetPacket {
+    char magic[4]; // "CRNP"
+    uint8_t player;
+    uint8_t count; // inputs that follow
+    uint16_t reserved;
+    uint64_t seed;
+    uint32_t firstTick; // tick of inputs[0]
+    uint32_t ackTick;   // sender holds every input of the receiver before this tick
+    uint32_t hashTick;  // latest tick whose state is final on the sender
+    uint32_t reserved2;
+    uint64_t hash;
+    uint8_t inputs[NET_INPUT_TICKS];
+};
+
+// FNV-1a over the meaningful bytes of a snapshot; padding is zeroed by captureSnapshot()
+uint64_t stateHash(const Snapshot &s) {
+    const auto *bytes = reinterpret_cast<const uint8_t *>(&s);
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0, n = snapshotSize(s); i < n; ++i) {
+        h = (h ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+struct NetStats {
+    uint32_t rollbacks = 0;
+    uint32_t resimulatedTicks = 0;
+    uint32_t stalledTicks = 0;
+    uint32_t desyncs = 0;
+    uint32_t maxRollback = 0;
+};
+
+struct NetSession {
+    bool active = false;
+    int localPlayer = 0;
+    UdpSocket socket;
+    std::array<sockaddr_in, MAX_PLAYERS> peers{};
+    std::array<bool, MAX_PLAYERS> heard{};
+
+    // rings indexed by tick: inputs used to simulate a tick, and the state at its start
+    std::array<TickInput, NET_INPUT_TICKS> inputs{};
+    std::array<Snapshot, NET_ROLLBACK_TICKS> snapshots;
+    std::array<uint64_t, NET_ROLLBACK_TICKS> hashes{};
+
+    std::array<uint32_t, MAX_PLAYERS> received{}; // every input of player p before this tick is known
+    std::array<uint8_t, MAX_PLAYERS> lastInput{}; // latest known input of player p, used as the prediction
+    std::array<uint32_t, MAX_PLAYERS> peerAck{};  // peer p holds our inputs before this tick
+    std::array<uint32_t, MAX_PLAYERS> peerHashTick{};
+    std::array<uint64_t, MAX_PLAYERS> peerHash{};
+    uint32_t rollbackTo = UINT32_MAX;
+    uint32_t finalTick = 0; // states at the start of ticks up to here are final and hashed
+    NetStats stats;
+
+    bool start(int player, int count, uint16_t port, const std::vector<const char *> &peerAddrs) {
+        if (count < 2 || count > MAX_PLAYERS || player < 0 || player >= count ||
+            static_cast<int>(peerAddrs.size()) != count - 1) {
+            std::cerr << "netplay needs --players 2.." << MAX_PLAYERS << ", --player 1..n and one --peer per "
+                      << "other player\n";
+            return false;
+        }
+        localPlayer = player;
+        playerCount = count;
+        for (int p = 0, next = 0; p < count; ++p) {
+            if (p == player) continue;
+            if (!parseAddress(peerAddrs[next++], peers[p])) {
+                std::cerr << "bad peer address " << peerAddrs[next - 1] << " (expected a.b.c.d:port)\n";
+                return false;
+            }
+        }
+        if (!openUdp(socket, port)) {
+            std::cerr << "cannot bind UDP port " << port << "\n";
+            return false;
+        }
+        received.fill(simTick);
+        peerAck.fill(simTick);
+        finalTick = simTick;
+        heard[player] = true;
+        active = true;
+        return true;
+    }
+
+    bool ready() const { return std::all_of(heard.begin(), heard.begin() + playerCount, [](bool h) { return h; }); }
+
+    // Every player's input is known for the ticks before this one
+    uint32_t confirmedTick() const {
+        return *std::min_element(received.begin(), received.begin() + playerCount);
+    }
+
+    TickInput &inputAt(uint32_t tick) { return inputs[tick % NET_INPUT_TICKS]; }
+
+    void receive() {
+        NetPacket pkt;
+        int size;
+        while ((size = recvUdp(socket, &pkt, sizeof(pkt))) > 0) {
+            if (static_cast<size_t>(size) < offsetof(NetPacket, inputs) || std::memcmp(pkt.magic, "CRNP", 4) != 0 ||
+                pkt.player >= playerCount || pkt.player == localPlayer ||
+                static_cast<size_t>(size) < offsetof(NetPacket, inputs) + pkt.count) {
+                continue;
+            }
+            if (pkt.seed != sessionSeed) {
+                std::cerr << "player " << pkt.player + 1 << " runs seed " << pkt.seed << ", ignoring it\n";
+                continue;
+            }
+
+            int p = pkt.player;
+            heard[p] = true;
+            peerAck[p] = std::max(peerAck[p], pkt.ackTick);
+            if (pkt.hashTick > peerHashTick[p]) {
+                peerHashTick[p] = pkt.hashTick;
+                peerHash[p] = pkt.hash;
+            }
+
+            // inputs arrive in order; take the ones that extend what we have
+            for (uint32_t i = 0; i < pkt.count; ++i) {
+                uint32_t tick = pkt.firstTick + i;
+                if (tick != received[p] || tick >= simTick + NET_ROLLBACK_TICKS) continue;
+                uint8_t &slot = inputAt(tick)[p];
+                if (tick < simTick && slot != pkt.inputs[i]) rollbackTo = std::min(rollbackTo, tick);
+                slot = pkt.inputs[i];
+                lastInput[p] = pkt.inputs[i];
+                ++received[p];
+            }
+        }
+    }
+
+    // Simulate the current tick with known inputs where there are some and predictions elsewhere
+    void step() {
+        TickInput &in = inputAt(simTick);
+        for (int p = 0; p < playerCount; ++p) {
+            if (received[p] <= simTick) in[p] = lastInput[p];
+        }
+        Snapshot &snap = snapshots[simTick % NET_ROLLBACK_TICKS];
+        captureSnapshot(snap);
+        simulateTick(in);
+    }
+
+    void rollback() {
+        if (rollbackTo >= simTick) {
+            rollbackTo = UINT32_MAX;
+            return;
+        }
+        uint32_t target = simTick;
+        restoreSnapshot(snapshots[rollbackTo % NET_ROLLBACK_TICKS]);
+        resimulating = true;
+        while (simTick < target) {
+            step();
+        }
+        resimulating = false;
+
+        ++stats.rollbacks;
+        stats.resimulatedTicks += target - rollbackTo;
+        stats.maxRollback = std::max(stats.maxRollback, target - rollbackTo);
+        rollbackTo = UINT32_MAX;
+    }
+
+    // Hash newly final states and compare with what the peers reported for the same ticks
+    void checkHashes() {
+        uint32_t last = std::min(confirmedTick(), simTick > 0 ? simTick - 1 : 0);
+        for (; finalTick <= last && finalTick < simTick; ++finalTick) {
+            hashes[finalTick % NET_ROLLBACK_TICKS] = stateHash(snapshots[finalTick % NET_ROLLBACK_TICKS]);
+        }
+        for (int p = 0; p < playerCount; ++p) {
+            uint32_t tick = peerHashTick[p];
+            if (p == localPlayer || tick == 0 || tick >= finalTick || tick + NET_ROLLBACK_TICKS <= finalTick) continue;
+            if (hashes[tick % NET_ROLLBACK_TICKS] != peerHash[p]) {
+                if (stats.desyncs++ == 0) {
+                    std::cerr << "desync with player " << p + 1 << " at tick " << tick
+                              << "; later ones are only counted\n";
+                }
+                telemetry.emit(TelemetryEvent::DESYNC, static_cast<uint16_t>(p), tick);
+            }
+            peerHashTick[p] = 0; // compared
+        }
+    }
+
+    void send() {
+        NetPacket pkt{};
+        std::memcpy(pkt.magic, "CRNP", 4);
+        pkt.player = static_cast<uint8_t>(localPlayer);
+        pkt.seed = sessionSeed;
+        pkt.hashTick = finalTick > 0 ? finalTick - 1 : 0;
+        pkt.hash = hashes[pkt.hashTick % NET_ROLLBACK_TICKS];
+
+        for (int p = 0; p < playerCount; ++p) {
+            if (p == localPlayer) continue;
+            // resend everything the peer has not acknowledged, so a lost packet costs nothing
+            uint32_t from = std::max(peerAck[p], received[localPlayer] > NET_INPUT_TICKS
+                                                     ? received[localPlayer] - NET_INPUT_TICKS
+                                                     : 0);
+            pkt.firstTick = from;
+            pkt.count = static_cast<uint8_t>(received[localPlayer] - from);
+            pkt.ackTick = received[p];
+            for (uint32_t i = 0; i < pkt.count; ++i) {
+                pkt.inputs[i] = inputAt(from + i)[localPlayer];
+            }
+            sendUdp(socket, peers[p], &pkt, offsetof(NetPacket, inputs) + pkt.count);
+        }
+    }
+
+    // One timer tick: apply late inputs, then advance unless too far ahead of the slowest peer
+    void update() {
+        receive();
+        rollback();
+
+        if (!ready() || simTick + 1 >= confirmedTick() + NET_ROLLBACK_TICKS) {
+            if (ready()) ++stats.stalledTicks;
+            send();
+            return;
+        }
+
+        uint8_t local = localInput(localPlayer);
+        inputAt(simTick)[localPlayer] = local;
+        lastInput[localPlayer] = local;
+        received[localPlayer] = simTick + 1;
+        step();
+
+        checkHashes();
+        send();
+    }
+};
+NetSession netSession;
+
+void drawNetStatus() {
+    TRACE_FUNCTION();
+    char buf[128];
+    glColor3d(1, 1, 0.3);
+    if (!netSession.ready()) {
+        auto joined = std::count(netSession.heard.begin(), netSession.heard.begin() + playerCount, true);
+        std::snprintf(buf, sizeof(buf), "WAITING FOR PLAYERS %d / %d", static_cast<int>(joined), playerCount);
+        drawText(-0.3, 0.9, buf);
+        return;
+    }
+    const NetStats &s = netSession.stats;
+    std::snprintf(buf, sizeof(buf), "P%d/%d  lead %u  rollbacks %u (max %u)  resim %u  stalls %u  desyncs %u",
+                  netSession.localPlayer + 1, playerCount, simTick - netSession.confirmedTick(), s.rollbacks,
+                  s.maxRollback, s.resimulatedTicks, s.stalledTicks, s.desyncs);
+    drawText(-0.95, 0.61, buf);
+}
+
+// #endregion Net
+
+// #region Spectator
+
+// Live view of the game for secondary displays: after each redraw the window is read back and a background thread
+// sends it to every connected TCP viewer as the XOR against the previous frame, run-length coded. Most of the screen
+// is unchanged between frames, so most of the XOR is zero runs. Sending never blocks: a viewer that has not taken
+// its last frame yet skips frames and resynchronizes with a key frame (coded against black) once it catches up.
+// Nothing is read back while no viewer is connected. After a partial redraw only the repainted rectangles are read
+// back, into a retained copy of the view, and the XOR is only computed inside them.
+//
+// Message: SpectatorFrameHeader, then payloadSize bytes of runs covering width * height RGBA words:
+//   varint(unchanged words) varint(changed words) changed words (XOR values, little endian) ...
+const uint16_t SPECTATOR_DEFAULT_PORT = 47900;
+
+struct SpectatorFrameHeader {
+    char magic[4]; // "CRSF"
+    uint16_t width, height;
+    uint32_t frame;
+    uint32_t payloadSize;
+    uint8_t keyFrame; // runs are against black instead of the previous frame
+    uint8_t reserved[3];
+};
+
+const size_t MAX_SPECTATOR_DIRTY = 32; // rectangles a delta can be limited to; more and the whole frame is compared
+
+// Append the runs of frame ^ base (base null: black) over a width x height image. With `dirty`, frame and base can
+// only differ inside those rectangles (image pixels), so nothing else is compared and it all codes as unchanged.
+void encodeFrameDelta(const uint32_t *frame, const uint32_t *base, int width, int height, std::vector<uint8_t> &out,
+                      const PixelRect *dirty = nullptr, size_t dirtyCount = 0) {
+    auto changed = [&](size_t i) { return (base ? frame[i] ^ base[i] : frame[i]) != 0; };
+    size_t words = static_cast<size_t>(width) * height;
+    size_t unchangedFrom = 0; // start of the unchanged run not written yet
+
+    // runs of changed words inside [begin, end); everything skipped extends the unchanged run
+    auto scan = [&](size_t begin, size_t end) {
+        size_t i = begin;
+        while (i < end) {
+            while (i < end && !changed(i)) ++i;
+            if (i == end) break;
+            size_t diff = i;
+            while (diff < end && changed(diff)) ++diff;
+            putVarint(out, i - unchangedFrom);
+            putVarint(out, diff - i);
+            for (size_t k = i; k < diff; ++k) {
+                uint32_t x = base ? frame[k] ^ base[k] : frame[k];
+                uint8_t bytes[4];
+                std::memcpy(bytes, &x, 4);
+                out.insert(out.end(), bytes, bytes + 4);
+            }
+            unchangedFrom = i = diff;
+        }
+    };
+
+    if (dirty == nullptr) {
+        scan(0, words);
+    } else {
+        for (int y = 0; y < height; ++y) {
+            // the row's dirty spans in x order, overlapping ones merged
+            FixedVector<std::pair<int, int>, MAX_SPECTATOR_DIRTY> spans;
+            for (size_t r = 0; r < dirtyCount; ++r) {
+                const PixelRect &d = dirty[r];
+                if (y < d.y || y >= d.y + d.h) continue;
+                spans.push_back({std::max(d.x, 0), std::min(d.x + d.w, width)});
+            }
+            std::sort(spans.begin(), spans.end());
+            size_t row = static_cast<size_t>(y) * width;
+            int x = 0;
+            for (const auto &span : spans) {
+                int from = std::max(span.first, x);
+                if (from >= span.second) continue;
+                scan(row + from, row + span.second);
+                x = span.second;
+            }
+        }
+    }
+    if (unchangedFrom < words) {
+        putVarint(out, words - unchangedFrom);
+        putVarint(out, 0);
+    }
+}
+
+// XOR the runs into frame; false when they do not cover it exactly
+bool decodeFrameDelta(const uint8_t *data, size_t size, uint32_t *frame, size_t words) {
+    size_t pos = 0;
+    size_t i = 0;
+    while (pos < size) {
+        i += getVarint(data, pos, size);
+        size_t diff = getVarint(data, pos, size);
+        if (i + diff > words || pos + diff * 4 > size) return false;
+        for (size_t k = 0; k < diff; ++k, pos += 4) {
+            uint32_t x;
+            std::memcpy(&x, data + pos, 4);
+            frame[i++] ^= x;
+        }
+    }
+    return i == words;
+}
+
+struct SpectatorClient {
+    SocketHandle socket = NO_SOCKET;
+    std::vector<uint8_t> out; // message being sent
+    size_t sent = 0;
+    uint32_t frame = 0; // last frame queued, 0 for none
+};
+
+struct SpectatorServer {
+    SocketHandle listener = NO_SOCKET;
+    std::thread sender;
+    std::atomic<bool> running{false};
+    std::atomic<int> clientCount{0};
+
+    // game thread: the view as last read back, patched rectangle by rectangle as frames change it, and the copy
+    // handed over by swapping with `pending`
+    std::vector<uint32_t> retained, capture;
+    int retainedW = 0, retainedH = 0; // 0: nothing retained, the next read-back takes the whole view
+
+    std::mutex mutex;
+    std::condition_variable frameReady;
+    std::vector<uint32_t> pending;
+    int pendingW = 0, pendingH = 0;
+    bool hasPending = false;
+    bool pendingFull = false; // changes since the frame the sender took last: anywhere, or only in pendingDirty
+    FixedVector<PixelRect, MAX_SPECTATOR_DIRTY> pendingDirty;
+
+    // sender thread
+    std::vector<uint32_t> frame, previous;
+    int width = 0, height = 0;
+    bool sameSize = false; // previous has the dimensions of frame
+    bool frameFull = false; // frame differs from previous anywhere, or only in frameDirty
+    FixedVector<PixelRect, MAX_SPECTATOR_DIRTY> frameDirty;
+    uint32_t frameNumber = 0;
+    std::vector<uint8_t> delta, key; // encoded messages of frameNumber, built on demand
+    uint32_t deltaFor = 0, keyFor = 0;
+    std::vector<SpectatorClient> clients;
+
+    ~SpectatorServer() { stop(); }
+
+    bool start(uint16_t port) {
+        if (!listenTcp(listener, port)) return false;
+        running = true;
+        sender = std::thread([this] {
+            TRACE_THREAD("spectators");
+            sendLoop();
+        });
+        return true;
+    }
+
+    void stop() {
+        if (!running.exchange(false)) return;
+        frameReady.notify_one();
+        sender.join();
+        for (SpectatorClient &c : clients) {
+            closeSocket(c.socket);
+        }
+        closeSocket(listener);
+    }
+
+    // Game thread, after a frame is complete: read back what `damage` says changed in the view and hand the
+    // result to the sender, replacing a frame it has not picked up yet
+    void captureFrame(const ViewRect &v, const Damage &damage) {
+        if (clientCount.load(std::memory_order_relaxed) == 0) {
+            retainedW = retainedH = 0;
+            return;
+        }
+        bool whole = damage.full || v.w != retainedW || v.h != retainedH;
+        if (!whole && damage.rects.empty()) return; // the viewers already have this picture
+
+        retained.resize(static_cast<size_t>(v.w) * v.h);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        if (whole) {
+            glReadPixels(v.x, v.y, v.w, v.h, GL_RGBA, GL_UNSIGNED_BYTE, retained.data());
+        } else {
+            // each rectangle lands in place inside the retained image
+            glPixelStorei(GL_PACK_ROW_LENGTH, v.w);
+            for (const PixelRect &r : damage.rects) {
+                glPixelStorei(GL_PACK_SKIP_PIXELS, r.x - v.x);
+                glPixelStorei(GL_PACK_SKIP_ROWS, r.y - v.y);
+                glReadPixels(r.x, r.y, r.w, r.h, GL_RGBA, GL_UNSIGNED_BYTE, retained.data());
+            }
+            glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+            glPixelStorei(GL_PACK_SKIP_PIXELS, 0);
+            glPixelStorei(GL_PACK_SKIP_ROWS, 0);
+        }
+        retainedW = v.w;
+        retainedH = v.h;
+        capture = retained;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.swap(capture);
+            if (!hasPending) {
+                pendingFull = false;
+                pendingDirty.clear();
+            }
+            pendingFull = pendingFull || whole || pendingDirty.size() + damage.rects.size() > MAX_SPECTATOR_DIRTY;
+            if (!pendingFull) {
+                for (const PixelRect &r : damage.rects) pendingDirty.push_back({r.x - v.x, r.y - v.y, r.w, r.h});
+            }
+            pendingW = v.w;
+            pendingH = v.h;
+            hasPending = true;
+        }
+        frameReady.notify_one();
+    }
+
+    void sendLoop() {
+        while (running) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                // wake up now and then to accept viewers and drain their sockets
+                frameReady.wait_for(lock, std::chrono::milliseconds(10), [this] { return hasPending || !running; });
+                if (hasPending) {
+                    previous.swap(frame);
+                    frame.swap(pending);
+                    sameSize = pendingW == width && pendingH == height;
+                    frameFull = pendingFull;
+                    frameDirty = pendingDirty;
+                    width = pendingW;
+                    height = pendingH;
+                    hasPending = false;
+                    ++frameNumber;
+                }
+            }
+
+            acceptClients();
+            for (size_t i = 0; i < clients.size();) {
+                if (serve(clients[i])) {
+                    ++i;
+                } else {
+                    closeSocket(clients[i].socket);
+                    clients.erase(clients.begin() + static_cast<std::ptrdiff_t>(i));
+                    clientCount = static_cast<int>(clients.size());
+                }
+            }
+        }
+    }
+
+    void acceptClients() {
+        SocketHandle s;
+        while ((s = acceptTcp(listener)) != NO_SOCKET) {
+            clients.push_back({s, {}, 0, 0});
+            clientCount = static_cast<int>(clients.size());
+        }
+    }
+
+    // Push pending bytes, then queue the newest frame if the viewer is idle; false once the viewer is gone
+    bool serve(SpectatorClient &c) {
+        if (!flush(c)) return false;
+        if (c.sent < c.out.size() || frameNumber == 0 || c.frame == frameNumber) return true;
+
+        // a viewer that holds the previous frame gets the delta, anyone else a key frame
+        bool asDelta = sameSize && c.frame + 1 == frameNumber;
+        c.out = asDelta ? message(delta, deltaFor, previous.data()) : message(key, keyFor, nullptr);
+        c.sent = 0;
+        c.frame = frameNumber;
+        return flush(c);
+    }
+
+    const std::vector<uint8_t> &message(std::vector<uint8_t> &msg, uint32_t &builtFor, const uint32_t *base) {
+        if (builtFor == frameNumber) return msg;
+        msg.resize(sizeof(SpectatorFrameHeader));
+        bool limited = base != nullptr && !frameFull;
+        encodeFrameDelta(frame.data(), base, width, height, msg, limited ? frameDirty.data() : nullptr,
+                         frameDirty.size());
+        SpectatorFrameHeader hdr{{'C', 'R', 'S', 'F'},
+                                 static_cast<uint16_t>(width),
+                                 static_cast<uint16_t>(height),
+                                 frameNumber,
+                                 static_cast<uint32_t>(msg.size() - sizeof(SpectatorFrameHeader)),
+                                 static_cast<uint8_t>(base == nullptr),
+                                 {}};
+        std::memcpy(msg.data(), &hdr, sizeof(hdr));
+        builtFor = frameNumber;
+        return msg;
+    }
+
+    bool flush(SpectatorClient &c) {
+        while (c.sent < c.out.size()) {
+            int n = sendTcp(c.socket, c.out.data() + c.sent, c.out.size() - c.sent);
+            if (n < 0) return false;
+            if (n == 0) break;
+            c.sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+};
+SpectatorServer spectators;
+
+// `CarRace --spectate <a.b.c.d:port>`: window that shows a spectator stream
+struct SpectatorViewer {
+    SocketHandle socket = NO_SOCKET;
+    std::vector<uint8_t> inbox; // received bytes not yet decoded
+    std::vector<uint32_t> pixels;
+    int width = 0, height = 0;
+    int windowW = WIDTH, windowH = HEIGHT;
+    uint64_t bytesReceived = 0;
+};
+SpectatorViewer viewer;
+
+void viewerDisplay() {
+    glClearColor(0, 0, 0, 1);
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (viewer.width > 0) {
+        glRasterPos2d(-1.0, -1.0);
+        glPixelZoom(static_cast<float>(viewer.windowW) / viewer.width,
+                    static_cast<float>(viewer.windowH) / viewer.height);
+        glDrawPixels(viewer.width, viewer.height, GL_RGBA, GL_UNSIGNED_BYTE, viewer.pixels.data());
+    }
+    glFlush();
+}
+
+void viewerReshape(int w, int h) {
+    viewer.windowW = w;
+    viewer.windowH = h;
+    glViewport(0, 0, w, h);
+}
+
+// Apply every complete message in the inbox; false on a malformed stream
+bool viewerDecode() {
+    size_t pos = 0;
+    bool shown = false;
+    while (viewer.inbox.size() - pos >= sizeof(SpectatorFrameHeader)) {
+        SpectatorFrameHeader hdr;
+        std::memcpy(&hdr, viewer.inbox.data() + pos, sizeof(hdr));
+        if (std::memcmp(hdr.magic, "CRSF", 4) != 0) return false;
+        if (viewer.inbox.size() - pos - sizeof(hdr) < hdr.payloadSize) break;
+
+        if (hdr.keyFrame || hdr.width != viewer.width || hdr.height != viewer.height) {
+            if (!hdr.keyFrame) return false; // a delta against a frame we never had
+            viewer.width = hdr.width;
+            viewer.height = hdr.height;
+            viewer.pixels.assign(static_cast<size_t>(hdr.width) * hdr.height, 0);
+        }
+        if (!decodeFrameDelta(viewer.inbox.data() + pos + sizeof(hdr), hdr.payloadSize, viewer.pixels.data(),
+                              viewer.pixels.size())) {
+            return false;
+        }
+        pos += sizeof(hdr) + hdr.payloadSize;
+        shown = true;
+    }
+    viewer.inbox.erase(viewer.inbox.begin(), viewer.inbox.begin() + static_cast<std::ptrdiff_t>(pos));
+    if (shown) glutPostRedisplay();
+    return true;
+}
+
+void viewerPoll(int) {
+    std::array<uint8_t, 64 * 1024> chunk;
+    int n;
+    while ((n = recvTcp(viewer.socket, chunk.data(), chunk.size())) > 0) {
+        viewer.inbox.insert(viewer.inbox.end(), chunk.begin(), chunk.begin() + n);
+        viewer.bytesReceived += static_cast<uint64_t>(n);
+    }
+    if (n < 0) {
+        std::cout << "spectator stream ended after " << viewer.bytesReceived << " bytes\n";
+        exit(0);
+    }
+    if (!viewerDecode()) {
+        std::cerr << "malformed spectator stream\n";
+        exit(1);
+    }
+    glutTimerFunc(TICK_MS / 2, viewerPoll, 0);
+}
+
+int runSpectatorViewer(int argc, char **argv, const char *address) {
+    sockaddr_in addr;
+    if (!parseAddress(address, addr)) {
+        std::cerr << "bad spectator address " << address << " (expected a.b.c.d:port)\n";
+        return 1;
+    }
+    if (!connectTcp(viewer.socket, addr)) {
+        std::cerr << "cannot connect to " << address << "\n";
+        return 1;
+    }
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB);
+    glutInitWindowSize(WIDTH, HEIGHT);
+    glutCreateWindow("Car Race - Spectator");
+    glutDisplayFunc(viewerDisplay);
+    glutReshapeFunc(viewerReshape);
+    glutTimerFunc(TICK_MS / 2, viewerPoll, 0);
+    glutMainLoop();
+    return 0;
+}
+
+// #endregion Spectator
+
+// #region Tournament
+
+// `--tournament <n>` runs n independent races, seeded seed, seed + 1, ..., as a grid of viewports in one window.
+// The simulation works on one set of globals, so each race lives in a snapshot plus its scenery and is swapped in
+// to tick and to draw. The focused race (Tab moves the focus) takes the keyboard and the others drive themselves.
+// Every tile records into the same render queue, which sorts all of them into one submission per frame: car meshes
+// and palette colors batch across races, and the HUD labels use the one GLUT font.
+const int MAX_TOURNAMENT_RACES = 16;
+
+void init();
+void recordWorld();
+
+// Scenery a snapshot rebuilds from its generator; a race swapped in every tick keeps a copy instead
+struct SceneryState {
+    SceneryType type;
+    Pcg32 rng, initRng;
+    uint32_t ticks;
+    decltype(leftGrassBlades) leftGrass, rightGrass;
+    decltype(leftCt) leftCacti, rightCacti;
+    decltype(leftWaves) leftRiver, rightRiver;
+    double waveTime;
+};
+
+void captureScenery(SceneryState &s) {
+    s.type = currentScenery;
+    s.rng = sceneryGen;
+    s.initRng = sceneryInitGen;
+    s.ticks = sceneryTicks;
+    s.leftGrass = leftGrassBlades;
+    s.rightGrass = rightGrassBlades;
+    s.leftCacti = leftCt;
+    s.rightCacti = rightCt;
+    s.leftRiver = leftWaves;
+    s.rightRiver = rightWaves;
+    s.waveTime = waveTime;
+}
+
+void restoreScenery(const SceneryState &s) {
+    currentScenery = s.type;
+    sceneryGen = s.rng;
+    sceneryInitGen = s.initRng;
+    sceneryTicks = s.ticks;
+    leftGrassBlades = s.leftGrass;
+    rightGrassBlades = s.rightGrass;
+    leftCt = s.leftCacti;
+    rightCt = s.rightCacti;
+    leftWaves = s.leftRiver;
+    rightWaves = s.rightRiver;
+    waveTime = s.waveTime;
+}
+
+struct Race {
+    uint64_t seed = 0;
+    Snapshot state;
+    SceneryState scenery;
+    Autopilot driver; // steers whenever the race is not the focused one
+};
+
+struct Tournament {
+    bool active = false;
+    std::vector<Race> races;
+    int focus = 0;
+    int cols = 1, rows = 1;
+
+    void start(int count, uint64_t seed) {
+        races.resize(count);
+        cols = static_cast<int>(std::ceil(std::sqrt(count)));
+        rows = (count + cols - 1) / cols;
+        for (int i = 0; i < count; ++i) {
+            Race &r = races[i];
+            r.seed = seed + i;
+            seedSession(r.seed);
+            simTick = 0;
+            init();
+            // one autopilot budget shared by every race
+            r.driver.budgetMs = autopilot.budgetMs / count;
+            r.driver.setEnabled(true);
+            leave(r);
+        }
+        active = true;
+    }
+
+    void enter(const Race &r) {
+        sessionSeed = r.seed;
+        restoreSimulation(r.state);
+        restoreScenery(r.scenery);
+    }
+
+    void leave(Race &r) {
+        captureSnapshot(r.state);
+        captureScenery(r.scenery);
+    }
+
+    void focusNext() { focus = (focus + 1) % static_cast<int>(races.size()); }
+
+    void tick() {
+        for (int i = 0; i < static_cast<int>(races.size()); ++i) {
+            Race &r = races[i];
+            enter(r);
+            uint8_t bits = i == focus ? sampleInput() : 0;
+            if (i != focus || autopilot.enabled) {
+                bits = static_cast<uint8_t>((bits & ~STEERING_INPUTS) | r.driver.decide(0));
+            }
+            // the other races are not the player's runs: like a resimulation they stay off the console, out of
+            // the results and out of telemetry
+            resimulating = i != focus;
+            simulateTick({bits});
+            resimulating = false;
+            leave(r);
+        }
+    }
+
+    // Pixels of race i: its grid cell, row 0 at the top, shrunk to the game's aspect ratio
+    ViewRect tile(int i) const {
+        int cellW = view.windowW / cols, cellH = view.windowH / rows;
+        return fitView(i % cols * cellW, view.windowH - (i / cols + 1) * cellH, cellW, cellH);
+    }
+
+    void draw() {
+        glViewport(0, 0, view.windowW, view.windowH);
+        glClearColor(0, 0, 0, 1);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        rqBeginFrame();
+        for (int i = 0; i < static_cast<int>(races.size()); ++i) {
+            enter(races[i]);
+            ViewRect t = tile(i);
+            rq.tile = {static_cast<float>(t.w) / view.windowW, static_cast<float>(t.h) / view.windowH,
+                       static_cast<float>((2.0 * t.x + t.w) / view.windowW - 1.0),
+                       static_cast<float>((2.0 * t.y + t.h) / view.windowH - 1.0), true};
+            recordWorld();
+        }
+        rq.tile = {};
+        rqFlush();
+
+        char buf[64];
+        for (int i = 0; i < static_cast<int>(races.size()); ++i) {
+            const Snapshot &s = races[i].state;
+            ViewRect t = tile(i);
+            glViewport(t.x, t.y, t.w, t.h);
+            std::snprintf(buf, sizeof(buf), "#%d  %lld%s", i + 1, static_cast<long long>(s.score),
+                          s.gameOver ? "  CRASHED" : s.gameFinished ? "  FINISHED" : "");
+            if (i == focus) {
+                glColor3d(1, 1, 0.3);
+                glBegin(GL_LINE_LOOP);
+                glVertex2d(-0.995, -0.995);
+                glVertex2d(0.995, -0.995);
+                glVertex2d(0.995, 0.995);
+                glVertex2d(-0.995, 0.995);
+                glEnd();
+            } else {
+                glColor3d(1, 1, 1);
+            }
+            drawText(-0.95, 0.85, buf);
+        }
+        glViewport(0, 0, view.windowW, view.windowH);
+    }
+};
+Tournament tournament;
+
+// #endregion Tournament
+
+void drawReplayStatus() {
+    TRACE_FUNCTION();
+    int now = static_cast<int>(simTick) * TICK_MS / 1000;
+    int total = static_cast<int>(replayPlayer.totalTicks()) * TICK_MS / 1000;
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "REPLAY %02d:%02d / %02d:%02d  [ / ] seek", now / 60, now % 60, total / 60,
+                  total % 60);
+    glColor3d(1, 1, 0.3);
+    drawText(-0.3, 0.9, buf);
+}
+
+// The tick timer is only re-armed while ticks can change something. Paused, hidden, and on a results screen
+// whose explosion has burnt out, the loop sleeps in glutMainLoop() and every key press arms one more tick, so input
+// that arrives meanwhile is applied and shown. Netplay never sleeps: peers need our input every tick, so a hidden
+// window only stops redrawing.
+bool windowVisible = true;
+bool tickArmed = false;
+
+void update(int value);
+
+bool loopAsleep() {
+    if (netSession.active) return false;
+    if (paused || !windowVisible) return true;
+    if (tournament.active) return false; // the other races restart by themselves
+    if (replayPlayer.active) return replayPlayer.finished();
+    if (autopilot.enabled) return false; // starts the next run by itself
+    return (gameOver || gameFinished) && !explosion.active;
+}
+
+void armTick() {
+    if (tickArmed) return;
+    tickArmed = true;
+    glutTimerFunc(tickPeriodMs, update, 0);
+}
+
+void windowStatus(int state) {
+    windowVisible = state != GLUT_HIDDEN && state != GLUT_FULLY_COVERED;
+    if (!windowVisible && !netSession.active && !gameOver && !gameFinished) paused = true;
+    windowDisturbed = true;
+    if (windowVisible) glutPostRedisplay();
+}
+
+void drawPausedOverlay() {
+    TRACE_FUNCTION();
+    glColor3d(1, 1, 1);
+    drawText(-0.15, 0.05, "PAUSED");
+    drawText(-0.4, -0.05, "Press P to Resume");
+}
+
+void keyboardNormal(unsigned char key, int x, int y) {
+    if (key == 27) { // Esc key
+        exit(0);
+    } else if ((key == 'p' || key == 'P') && !netSession.active) {
+        paused = !paused;
+        glutPostRedisplay();
+    } else if (key == '\t' && tournament.active) {
+        tournament.focusNext();
+        glutPostRedisplay();
+    } else if (replayPlayer.active) {
+        // replay controls: step 10 seconds back / forward
+        int step = 10000 / TICK_MS;
+        if (key == '[') replayPlayer.seek(simTick > static_cast<uint32_t>(step) ? simTick - step : 0);
+        if (key == ']') replayPlayer.seek(simTick + step);
+    } else if (key == 13) { // Enter key
+        oneShotEvent(INPUT_RESET, INPUT_RESET);
+    } else if (key >= '1' && key <= '3') {
+        oneShotEvent(static_cast<uint8_t>((key - '0') << INPUT_SCENERY_SHIFT), 3 << INPUT_SCENERY_SHIFT);
+    } else if (key == 'a' || key == 'A') {
+        keyEvent(KEY_LEFT, true);
+    } else if (key == 'd' || key == 'D') {
+        keyEvent(KEY_RIGHT, true);
+    } else if (key == 'w' || key == 'W') {
+        keyEvent(KEY_UP, true);
+    } else if (key == 's' || key == 'S') {
+        keyEvent(KEY_DOWN, true);
+    }
+    armTick();
+}
+
+void keyboardNormalUp(unsigned char key, int x, int y) {
+    if (key == 'a' || key == 'A') {
+        keyEvent(KEY_LEFT, false);
+    } else if (key == 'd' || key == 'D') {
+        keyEvent(KEY_RIGHT, false);
+    } else if (key == 'w' || key == 'W') {
+        keyEvent(KEY_UP, false);
+    } else if (key == 's' || key == 'S') {
+        keyEvent(KEY_DOWN, false);
+    }
+}
+
+void init() {
+    initScenery(currentScenery);
+    initRoad();
+    initCarMasks();
+    initEnemies();
+    initBridge();
+    initExplosion();
+    resetPlayers();
+    gameStartTimeMs = simTimeMs();
+    // Initialize non-wrapping scroll anchors so lines don't reappear on laneOffset wrap
+    roadScroll = Coord{0.0};
+    startScroll0 = roadScroll;
+    finishLineSpawned = false;
+    startRaceEvents();
+}
+
+// Bounds of everything drawCar() emits for a car centered at (x, y)
+Bounds carBounds(double x, double y) {
+    return {x + MASK_MIN_X * carWidth, y + MASK_MIN_Y * carHeight, x + MASK_MAX_X * carWidth,
+            y + MASK_MAX_Y * carHeight};
+}
+
+// Bounds of the square drawExplosion() emits for a particle
+Bounds particleBounds(const Position &p, const Lifetime &life) {
+    double size = 0.02 * life.remaining / life.initial;
+    return {p.x - size, p.y - size, p.x + size, p.y + size};
+}
+
+// Bounds of everything drawBridge() emits for a bridge
+Bounds bridgeBounds(const Bridge &b) {
+    double railing = 0.02; // shadow and railings stick out of the deck
+    return {-1.0, b.y - b.shadowOffset - railing, 1.0 + b.shadowOffset, b.y + b.height + railing};
+}
+
+// Build this frame's visible lists; invisible and inactive items never reach the draw functions
+void cullScene() {
+    TRACE_FUNCTION();
+    cullStats = {};
+
+    switch (currentScenery) {
+    case SceneryType::GRASS: {
+        size_t n = std::min<size_t>(lod().grassBlades, leftGrassBlades.size());
+        cullItems(leftGrassBlades.data(), n, visibleLeftScenery, [](const std::pair<double, double> &b) {
+            return Bounds{b.first, b.second, b.first + 0.01, b.second + 0.03};
+        });
+        cullItems(rightGrassBlades.data(), n, visibleRightScenery, [](const std::pair<double, double> &b) {
+            return Bounds{b.first - 0.01, b.second, b.first, b.second + 0.03};
+        });
+        break;
+    }
+    case SceneryType::DESERT: {
+        size_t n = std::min<size_t>(lod().cacti, leftCt.size());
+        auto cactusBounds = [](const Cactus &c) {
+            double r = c.size * 0.35; // spikes reach further than the body
+            return Bounds{c.x - r, c.y - r, c.x + r, c.y + r};
+        };
+        cullItems(leftCt.data(), n, visibleLeftScenery, cactusBounds);
+        cullItems(rightCt.data(), n, visibleRightScenery, cactusBounds);
+        break;
+    }
+    case SceneryType::RIVER: {
+        size_t n = std::min<size_t>(lod().waves, leftWaves.size());
+        auto waveBounds = [](const WavePoint &w) {
+            return Bounds{w.x - 0.05, w.y - w.amplitude, w.x + 0.05, w.y + w.amplitude};
+        };
+        cullItems(leftWaves.data(), n, visibleLeftScenery, waveBounds);
+        cullItems(rightWaves.data(), n, visibleRightScenery, waveBounds);
+        break;
+    }
+    }
+
+    cullItems(enemies.column<Position>(), enemies.size(), visibleEnemies,
+              [](const Position &p) { return carBounds(p.x, p.y); });
 
-    // Top railing (front edge)
-    glColor3d(0.7, 0.7, 0.7);
-    glBegin(GL_QUADS);
-    glVertex2d(bridgeLeft, bridgeTop);
-    glVertex2d(bridgeRight, bridgeTop);
-    glVertex2d(bridgeRight, bridgeTop + railingHeight);
-    glVertex2d(bridgeLeft, bridgeTop + railingHeight);
-    glEnd();
+    const ParticleTable &pt = explosion.particles;
+    size_t particles = explosion.active ? std::min<size_t>(lod().particles, pt.size()) : 0;
+    const Position *pos = pt.column<Position>();
+    const Lifetime *life = pt.column<Lifetime>();
+    cullRows(particles, visibleParticles, [&](uint32_t i) { return particleBounds(pos[i], life[i]); });
 
-    // Bottom railing (back edge)
-    glBegin(GL_QUADS);
-    glVertex2d(bridgeLeft, bridgeBottom - railingHeight);
-    glVertex2d(bridgeRight, bridgeBottom - railingHeight);
-    glVertex2d(bridgeRight, bridgeBottom);
-    glVertex2d(bridgeLeft, bridgeBottom);
-    glEnd();
+    cullItems(bridges.column<Bridge>(), bridges.size(), visibleBridges, bridgeBounds);
+}
 
-    // Draw a single dashed lane marking at the center
-    glColor3d(1, 1, 0.8);
-    double markingHeight = 0.02; // thickness of the line
-    double dashLength = 0.1;     // length of each dash
-    double dashGap = 0.1;        // gap between dashes
-    double centerY = (bridgeTop + bridgeBottom) / 2.0;
+// Cull and record the world into the render queue
+void recordWorld() {
+    cullScene();
+    drawScenery();
+    drawRoad();
+    drawPlayers();
+    drawEnemies();
+    drawBridge();
+    drawExplosion();
+}
 
-    for (double x = bridgeLeft; x < bridgeRight; x += dashLength + dashGap) {
-        glBegin(GL_QUADS);
-        glVertex2d(x, centerY - markingHeight / 2);
-        glVertex2d(x + dashLength, centerY - markingHeight / 2);
-        glVertex2d(x + dashLength, centerY + markingHeight / 2);
-        glVertex2d(x, centerY + markingHeight / 2);
-        glEnd();
-    }
+// Everything below the HUD goes through the render queue
+void drawWorld() {
+    TRACE_FUNCTION();
+    rqBeginFrame();
+    recordWorld();
+    rqFlush();
 }
 
-void drawBridge() { drawBridge(bridge); }
+// HUD text, drawn directly on top of the world
+void drawHud() {
+    drawScore();
+    drawTimer();
 
-void updateBridge() {
-    if (gameFinished) return;
+    if (gameOver) {
+        drawGameOverOverlay();
+    }
 
-    // Check if it's time to spawn a new bridge
-    int now = glutGet(GLUT_ELAPSED_TIME);
-    if (now - lastBridgeSpawnTime >= BRIDGE_SPAWN_INTERVAL_MS) {
-        // Random chance to spawn bridge (70% probability)
-        if (RandReal(0.0, 1.0)(gen) < 0.7) {
-            spawnBridge();
-        }
-        lastBridgeSpawnTime = now;
+    if (gameFinished) {
+        drawContratulationsOverlay();
     }
 
-    if (bridge.active) {
-        bridge.y -= 0.01; // Move bridge down with road
+    if (paused) {
+        drawPausedOverlay();
+    }
 
-        // Deactivate bridge when it goes off screen
-        if (bridge.y < -1.5) {
-            bridge.active = false;
-        }
+    if (replayPlayer.active) {
+        drawReplayStatus();
     }
-}
 
-// #endregion Bridge
+    if (netSession.active && (showStats || !netSession.ready())) {
+        drawNetStatus();
+    }
 
-// #region Explosion
+    if (autopilot.enabled) {
+        drawAutopilotStatus(showStats ? 0.54 : -2.0);
+    }
 
-struct Particle {
-    double x, y;        // Position
-    double vx, vy;      // Velocity
-    double r, g, b;     // Color
-    double lifetime;    // Remaining lifetime
-    double maxLifetime; // Initial lifetime
-    bool active;
-};
+    if (showStats) {
+        drawStats();
+        drawLatencyStats(0.68);
+        drawObservation(netSession.active ? netSession.localPlayer : 0, 0.7, 0.5);
+    }
+}
 
-struct Explosion {
-    double x, y; // Explosion center
-    std::vector<Particle> particles;
-    bool active;
-    int maxParticles;
+// #region Damage
+
+// Partial redraw. The window is single-buffered, so the previous frame is still in it and a frame only has to
+// repaint what changed. Cars, bridges, the explosion and HUD text lines are compared one by one with the previous
+// frame. Everything else that shapes the picture (road scroll, scenery, detail level, geometry, the stats overlay)
+// goes into a signature, and any change there repaints the whole view, as does anything the window system may have
+// disturbed. Changed areas are merged into a few rectangles, each repainted under a scissor with culling narrowed
+// to it. While the road stands still (pause, game over, a netplay stall) drawing and the spectator read-back then
+// cost what the change costs, and a frame that changes nothing draws nothing.
+
+// Everything drawn besides the compared items that can differ between frames
+struct SceneSignature {
+    double laneOffset, roadScroll, startScroll0, finishScroll0;
+    bool startLine, finishLine;
+    SceneryType scenery;
+    uint32_t sceneryGeneration, sceneryTicks;
+    int lodLevel, resolutionLevel;
+    double roadWidth, carWidth, carHeight;
+    int viewX, viewY, viewW, viewH;
+
+    auto key() const {
+        return std::tie(laneOffset, roadScroll, startScroll0, finishScroll0, startLine, finishLine, scenery,
+                        sceneryGeneration, sceneryTicks, lodLevel, resolutionLevel, roadWidth, carWidth, carHeight,
+                        viewX, viewY, viewW, viewH);
+    }
 };
 
-Explosion explosion;
-const int MAX_EXPLOSION_PARTICLES = 20;
-const double EXPLOSION_DURATION = 1.0; // seconds
-
-void initExplosion() {
-    explosion.active = false;
-    explosion.maxParticles = MAX_EXPLOSION_PARTICLES;
-    explosion.particles.reserve(MAX_EXPLOSION_PARTICLES);
+SceneSignature sceneSignature() {
+    return {double(laneOffset),
+            double(roadScroll),
+            double(startScroll0),
+            double(finishScroll0),
+            simTimeMs() - gameStartTimeMs <= START_LINE_SHOW_MS,
+            finishLineSpawned,
+            currentScenery,
+            sceneryGeneration,
+            sceneryTicks,
+            lodController.level,
+            resolution.level,
+            roadWidth,
+            carWidth,
+            carHeight,
+            view.x,
+            view.y,
+            view.w,
+            view.h};
 }
 
-void createExplosion(double x, double y) {
-    explosion.x = x;
-    explosion.y = y;
-    explosion.active = true;
-    explosion.particles.clear();
+struct DamageTracker {
+    static constexpr int MARGIN = 2;             // pixels around every rectangle, for rounding and line widths
+    static constexpr double FULL_FRACTION = 0.5; // damage over this share of the view repaints all of it
+    static constexpr int TEXT_DESCENT = 5;       // Helvetica 18 below and above the raster position
+    static constexpr int TEXT_ASCENT = 19;
 
-    // Create particles
-    RandReal angleDist(0.0, 2.0 * PI);
-    RandReal speedDist(0.1, 0.3);
-    RandReal lifetimeDist(0.5, 1.0);
+    bool valid = false; // the window shows the frame described below
+    SceneSignature scene{};
+    std::vector<Bounds> items, lastItems; // players, enemies, bridges, then the extent of the explosion
+    FixedVector<HudText, MAX_HUD_TEXTS> lastTexts;
 
-    for (int i = 0; i < MAX_EXPLOSION_PARTICLES; ++i) {
-        Particle p;
-        double angle = angleDist(gen);
-        double speed = speedDist(gen);
+    // What this frame must repaint, remembering it as the state of the window
+    Damage next(bool fullRequired) {
+        SceneSignature now = sceneSignature();
 
-        p.x = x;
-        p.y = y;
-        p.vx = cos(angle) * speed;
-        p.vy = sin(angle) * speed;
+        items.clear();
+        for (int i = 0; i < playerCount; ++i) {
+            items.push_back(carBounds(players[i].x, players[i].y));
+        }
+        const Position *pos = enemies.column<Position>();
+        for (size_t i = 0; i < enemies.size(); ++i) {
+            items.push_back(carBounds(pos[i].x, pos[i].y));
+        }
+        const Bridge *b = bridges.column<Bridge>();
+        for (size_t i = 0; i < bridges.size(); ++i) {
+            items.push_back(bridgeBounds(b[i]));
+        }
+        if (explosion.active) {
+            const ParticleTable &pt = explosion.particles;
+            const Position *p = pt.column<Position>();
+            const Lifetime *life = pt.column<Lifetime>();
+            Bounds extent{1.0, 1.0, -1.0, -1.0};
+            for (size_t i = 0; i < std::min<size_t>(lod().particles, pt.size()); ++i) {
+                Bounds pb = particleBounds(p[i], life[i]);
+                extent = {std::min(extent.minX, pb.minX), std::min(extent.minY, pb.minY),
+                          std::max(extent.maxX, pb.maxX), std::max(extent.maxY, pb.maxY)};
+            }
+            items.push_back(extent);
+        }
 
-        if (i % 3 == 0) {
-            p.r = 1.0;
-            p.g = 0.0;
-            p.b = 0.0; // Red
-        } else if (i % 3 == 1) {
-            p.r = 1.0;
-            p.g = 0.5;
-            p.b = 0.0; // Orange
-        } else {
-            p.r = 1.0;
-            p.g = 1.0;
-            p.b = 0.0; // Yellow
+        // the stats overlay is more than text and repaints everything anyway
+        hudTexts.clear();
+        if (!showStats) {
+            measuringHud = true;
+            drawHud();
+            measuringHud = false;
         }
 
-        p.lifetime = lifetimeDist(gen);
-        p.maxLifetime = p.lifetime;
-        p.active = true;
+        Damage d;
+        d.full = fullRequired || !valid || showStats || now.key() != scene.key();
+        if (!d.full) {
+            for (size_t i = 0; i < std::max(items.size(), lastItems.size()); ++i) {
+                bool isNew = i < items.size(), isOld = i < lastItems.size();
+                if (isNew && isOld && sameBounds(items[i], lastItems[i])) continue;
+                if (isNew) add(d, worldRect(items[i]));
+                if (isOld) add(d, worldRect(lastItems[i]));
+            }
+            for (size_t i = 0; i < std::max(hudTexts.size(), lastTexts.size()); ++i) {
+                bool isNew = i < hudTexts.size(), isOld = i < lastTexts.size();
+                if (isNew && isOld && sameText(hudTexts[i], lastTexts[i])) continue;
+                if (isNew) add(d, textRect(hudTexts[i]));
+                if (isOld) add(d, textRect(lastTexts[i]));
+            }
+            double area = 0.0;
+            for (const PixelRect &r : d.rects) area += static_cast<double>(r.w) * r.h;
+            if (area > FULL_FRACTION * view.w * view.h) d.full = true;
+        }
+        if (d.full) d.rects.clear();
 
-        explosion.particles.push_back(p);
+        scene = now;
+        lastItems.swap(items);
+        lastTexts = hudTexts;
+        valid = true;
+        return d;
     }
-}
-
-void updateExplosion() {
-    if (!explosion.active) return;
 
-    bool anyActive = false;
-    for (auto &p : explosion.particles) {
-        if (!p.active) continue;
+    static bool sameBounds(const Bounds &a, const Bounds &b) {
+        return a.minX == b.minX && a.minY == b.minY && a.maxX == b.maxX && a.maxY == b.maxY;
+    }
 
-        // Update position
-        p.x += p.vx * 0.016; // Assuming ~60 FPS
-        p.y += p.vy * 0.016;
+    static bool sameText(const HudText &a, const HudText &b) {
+        return a.x == b.x && a.y == b.y && a.width == b.width && a.hash == b.hash && a.color == b.color;
+    }
 
-        // Apply gravity
-        p.vy -= 0.5 * 0.016;
+    static PixelRect worldRect(const Bounds &b) {
+        int x0 = static_cast<int>(std::floor((b.minX + 1.0) * 0.5 * view.w));
+        int y0 = static_cast<int>(std::floor((b.minY + 1.0) * 0.5 * view.h));
+        int x1 = static_cast<int>(std::ceil((b.maxX + 1.0) * 0.5 * view.w));
+        int y1 = static_cast<int>(std::ceil((b.maxY + 1.0) * 0.5 * view.h));
+        return {view.x + x0 - MARGIN, view.y + y0 - MARGIN, x1 - x0 + 2 * MARGIN, y1 - y0 + 2 * MARGIN};
+    }
 
-        // Update lifetime
-        p.lifetime -= 0.016;
-        if (p.lifetime <= 0) {
-            p.active = false;
-        } else {
-            anyActive = true;
-        }
+    static PixelRect textRect(const HudText &t) {
+        int x = view.x + static_cast<int>(std::floor((t.x + 1.0) * 0.5 * view.w));
+        int y = view.y + static_cast<int>(std::floor((t.y + 1.0) * 0.5 * view.h));
+        return {x - MARGIN, y - TEXT_DESCENT - MARGIN, t.width + 2 * MARGIN, TEXT_DESCENT + TEXT_ASCENT + 2 * MARGIN};
     }
 
-    // Deactivate explosion when all particles are done
-    if (!anyActive) {
-        explosion.active = false;
+    static PixelRect unite(const PixelRect &a, const PixelRect &b) {
+        int x0 = std::min(a.x, b.x), y0 = std::min(a.y, b.y);
+        return {x0, y0, std::max(a.x + a.w, b.x + b.w) - x0, std::max(a.y + a.h, b.y + b.h) - y0};
     }
-}
 
-void drawExplosion() {
-    if (!explosion.active) return;
+    static bool touch(const PixelRect &a, const PixelRect &b) {
+        return a.x <= b.x + b.w && b.x <= a.x + a.w && a.y <= b.y + b.h && b.y <= a.y + a.h;
+    }
 
-    for (const auto &p : explosion.particles) {
-        if (!p.active) continue;
+    // Clip r to the view and merge it in; rectangles that touch become one, and once every slot is taken r
+    // swallows whichever rectangle grows it least
+    static void add(Damage &d, PixelRect r) {
+        int x0 = std::max(r.x, view.x), y0 = std::max(r.y, view.y);
+        int x1 = std::min(r.x + r.w, view.x + view.w), y1 = std::min(r.y + r.h, view.y + view.h);
+        if (x1 <= x0 || y1 <= y0) return;
+        r = {x0, y0, x1 - x0, y1 - y0};
+
+        for (;;) {
+            bool merged = false;
+            for (size_t i = 0; i < d.rects.size();) {
+                if (touch(d.rects[i], r)) {
+                    r = unite(r, d.rects[i]);
+                    d.rects[i] = d.rects[d.rects.size() - 1];
+                    d.rects.pop_back();
+                    merged = true;
+                } else {
+                    ++i;
+                }
+            }
+            if (merged) continue;
+            if (d.rects.size() < Damage::MAX_RECTS) break;
+
+            size_t best = 0;
+            double bestGrowth = 0.0;
+            for (size_t i = 0; i < d.rects.size(); ++i) {
+                PixelRect u = unite(r, d.rects[i]);
+                double growth = static_cast<double>(u.w) * u.h - static_cast<double>(d.rects[i].w) * d.rects[i].h;
+                if (i == 0 || growth < bestGrowth) {
+                    best = i;
+                    bestGrowth = growth;
+                }
+            }
+            r = unite(r, d.rects[best]);
+            d.rects[best] = d.rects[d.rects.size() - 1];
+            d.rects.pop_back();
+        }
+        d.rects.push_back(r);
+    }
+};
+DamageTracker damageTracker;
 
-        // Fade out over time
-        double alpha = p.lifetime / p.maxLifetime;
-        glColor3d(p.r * alpha, p.g * alpha, p.b * alpha);
+// Repaint one rectangle of the view from the current state
+void redrawRect(const PixelRect &r) {
+    glViewport(view.x, view.y, view.w, view.h);
+    glScissor(r.x, r.y, r.w, r.h);
+    glEnable(GL_SCISSOR_TEST);
+    glClearColor(0.53, 0.81, 0.92, 1);
+    glClear(GL_COLOR_BUFFER_BIT);
 
-        // Draw particle as small square
-        double size = 0.02 * alpha; // Shrink over time
-        glBegin(GL_QUADS);
-        glVertex2d(p.x - size, p.y - size);
-        glVertex2d(p.x + size, p.y - size);
-        glVertex2d(p.x + size, p.y + size);
-        glVertex2d(p.x - size, p.y + size);
-        glEnd();
-    }
+    // the same rectangle in clip space, for culling
+    cullBounds = {2.0 * (r.x - view.x) / view.w - 1.0, 2.0 * (r.y - view.y) / view.h - 1.0,
+                  2.0 * (r.x + r.w - view.x) / view.w - 1.0, 2.0 * (r.y + r.h - view.y) / view.h - 1.0};
+    drawWorld();
+    cullBounds = VIEW_BOUNDS;
+    drawHud();
+    glDisable(GL_SCISSOR_TEST);
 }
 
-// #endregion Explosion
+// #endregion Damage
 
-// #region Score
+// Shared end of every frame: measure it, feed the controllers and hand what `damage` says changed in `shown` to
+// the spectators
+void finishFrame(std::chrono::steady_clock::time_point frameStart, const ViewRect &shown, const Damage &damage) {
+    // wait for the frame to complete so the LOD controller sees the real rasterization cost
+    {
+        TRACE_ZONE("present");
+        glFinish();
+    }
 
-int64_t score = 0;
+    double frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+    frameStats.frameFinished(frameMs);
+    resolution.frameFinished(frameMs, lodController.budgetMs);
+    lodController.frameFinished(frameMs);
+    inputPresented();
+    spectators.captureFrame(shown, damage);
+}
 
-void updateScore() {
-    if (!gameFinished) {
-        score += 1;
+void display() {
+    FrameAllocGuard guard("frame");
+    TRACE_FUNCTION();
+    auto frameStart = std::chrono::steady_clock::now();
+    frameArena.reset();
+    bool exposed = !tickRedrawPosted || windowDisturbed;
+    tickRedrawPosted = false;
+    windowDisturbed = false;
+
+    if (tournament.active) {
+        tournament.draw();
+        if (paused) drawPausedOverlay();
+        windowDisturbed = true; // the tiles are not tracked; the first frame after the tournament starts afresh
+        finishFrame(frameStart, {0, 0, view.windowW, view.windowH, view.windowW, view.windowH}, Damage{});
+        return;
     }
-}
 
-void drawText(double x, double y, const std::string &text) {
-    glRasterPos2d(x, y);
-    for (char c : text) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, c);
+    int sceneW = std::max(1, static_cast<int>(std::lround(view.w * resolution.scale())));
+    int sceneH = std::max(1, static_cast<int>(std::lround(view.h * resolution.scale())));
+    bool upscaled = sceneW < view.w || sceneH < view.h;
+    Damage damage = damageTracker.next(exposed || upscaled);
+    if (damage.full) {
+        beginScene(sceneW, sceneH);
+        drawWorld();
+        if (upscaled) upscaleScene(sceneW, sceneH);
+        drawHud();
+    } else {
+        TRACE_ZONE("partial redraw");
+        for (const PixelRect &r : damage.rects) {
+            redrawRect(r);
+        }
     }
-}
 
-void drawScore() {
-    glColor3d(1, 1, 1);
-    std::string scoreText = "Score:" + std::to_string(score);
-    drawText(-0.95, 0.9, scoreText);
+    finishFrame(frameStart, view, damage);
 }
 
-void drawTimer() {
-    int now = glutGet(GLUT_ELAPSED_TIME);
-    int elapsedMs = now - gameStartTimeMs;
-    int totalSeconds = elapsedMs / 1000;
-    int minutes;
-    int seconds;
-
-    if (!gameOver || !gameFinished) {
-        minutes = totalSeconds / 60;
-        seconds = totalSeconds % 60;
+void keyboardSpecial(int key, int x, int y) {
+    if (key == GLUT_KEY_LEFT) {
+        keyEvent(KEY_LEFT, true);
+    } else if (key == GLUT_KEY_RIGHT) {
+        keyEvent(KEY_RIGHT, true);
+    } else if (key == GLUT_KEY_UP) {
+        keyEvent(KEY_UP, true);
+    } else if (key == GLUT_KEY_DOWN) {
+        keyEvent(KEY_DOWN, true);
+    } else if (key == GLUT_KEY_F2 && !replayPlayer.active) {
+        autopilot.setEnabled(!autopilot.enabled);
+    } else if (key == GLUT_KEY_F3) {
+        showStats = !showStats;
+        glutPostRedisplay();
+    } else if (key == GLUT_KEY_F4) {
+        if (writeTrace(TRACE_PATH)) {
+            std::cout << "trace written to " << TRACE_PATH << "\n";
+        } else {
+            std::cerr << "no trace written: needs a CARRACE_TRACE build and a writable " << TRACE_PATH << "\n";
+        }
     }
+    armTick();
+}
 
-    char buf[16];
-    std::snprintf(buf, sizeof(buf), "%02d:%02d", minutes, seconds);
-
-    glColor3d(1, 1, 1);
-    // place at top-right corner
-    drawText(0.8, 0.9, std::string("Time:") + buf);
+void keyboardSpecialUp(int key, int x, int y) {
+    if (key == GLUT_KEY_LEFT) {
+        keyEvent(KEY_LEFT, false);
+    } else if (key == GLUT_KEY_RIGHT) {
+        keyEvent(KEY_RIGHT, false);
+    } else if (key == GLUT_KEY_UP) {
+        keyEvent(KEY_UP, false);
+    } else if (key == GLUT_KEY_DOWN) {
+        keyEvent(KEY_DOWN, false);
+    }
 }
 
-// #endregion Score
+void update(int value) {
+    FrameAllocGuard guard("tick");
+    TRACE_FUNCTION();
+    tickArmed = false;
+    if (pollTuning()) replayRecorder.recordTuning();
+    if (paused) {
+        // a key woke the loop; nothing moves until P
+    } else if (tournament.active) {
+        tournament.tick();
+    } else if (replayPlayer.active) {
+        if (!replayPlayer.finished()) simulateTick({replayPlayer.nextInput()});
+    } else if (netSession.active) {
+        netSession.update();
+    } else {
+        uint8_t bits = localInput(0);
+        replayRecorder.recordTick(bits);
+        simulateTick({bits});
+    }
 
-// #region Enemy
+    if (windowVisible) {
+        tickRedrawPosted = true;
+        glutPostRedisplay();
+    }
+    if (!loopAsleep()) armTick();
+}
 
-struct EnemyCar {
-    double x, y;
-    CarType type;
-    double r, g, b;
-    bool active;
+// #region Scenario
+
+// Scripted, seeded benchmark sessions: `--scenario <name> [budgets file]` runs one without a window and prints
+// frame and tick time percentiles, peak RSS and heap allocations per frame. Frames go through the render queue
+// as usual (culling, recording, sorting, batching); only the GL calls are skipped. Detail is pinned to the highest
+// LOD level so the measured work does not depend on how fast the machine is.
+struct Scenario {
+    const char *name;
+    int enemies;           // cars in play
+    SceneryType scenery;   // at the start
+    int sceneryIntervalMs; // automatic scenery switch period
+    int explosionTicks;    // a scripted explosion every this many ticks, 0 = none
+    bool collisions;       // off keeps dense traffic from ending every run at once
 };
-std::array<EnemyCar, MAX_ENEMIES> enemies;
+const std::array<Scenario, 5> SCENARIOS{{
+    {"baseline", 4, SceneryType::DESERT, 10000, 0, true},
+    {"enemies-1k", 1000, SceneryType::DESERT, 10000, 0, false},
+    {"dense-grass", 4, SceneryType::GRASS, 1 << 30, 0, true},
+    {"explosion-storm", 4, SceneryType::RIVER, 10000, 4, true},
+    {"scenery-switch", 4, SceneryType::DESERT, 3 * TICK_MS, 0, true},
+}};
+const uint64_t SCENARIO_SEED = 1;
+const uint32_t SCENARIO_TICKS = 3000; // ~90 s of play, one frame per tick
+const uint32_t SCENARIO_WARMUP_TICKS = 300; // traffic needs 280 ticks to pass the screen and fill every buffer
+
+// Measured values, in the column order of the budgets file
+enum ScenarioMetric {
+    FRAME_P50,
+    FRAME_P99,
+    FRAME_MAX,
+    TICK_P50,
+    TICK_P99,
+    TICK_MAX,
+    PEAK_RSS_MB,
+    ALLOCS_PER_FRAME,
+    SCENARIO_METRIC_COUNT
+};
+const std::array<const char *, SCENARIO_METRIC_COUNT> SCENARIO_METRIC_NAMES{
+    "frame_p50_ms", "frame_p99_ms", "frame_max_ms", "tick_p50_ms",
+    "tick_p99_ms",  "tick_max_ms",  "peak_rss_mb",  "allocs_per_frame",
+};
+using ScenarioValues = std::array<double, SCENARIO_METRIC_COUNT>;
 
-void initEnemies() {
-    RandInt typeDist(0, 2);
-
-    using Color = std::array<double, 3>;
-    std::array<Color, 8> palette{{
-        {1.0, 1.0, 1.0},    // White
-        {0.4, 0.4, 0.4},    // Black
-        {0.75, 0.75, 0.75}, // Gray
-        {0.2, 0.2, 0.35},   // Dark Blue
-        {0.8, 0.0, 0.0},    // Red
-        {0.6, 0.0, 0.0},    // Maroon
-        {0.8, 0.6, 0.4},    // Beige
-        {0.0, 0.4, 0.2}     // Dark Green
-    }};
+// Weave across the road and restart whenever the run ends
+uint8_t scenarioInput(uint32_t tick) {
+    if (gameOver || gameFinished) return INPUT_RESET;
+    return (tick / 40) % 2 == 0 ? INPUT_LEFT : INPUT_RIGHT;
+}
 
-    // Random index distribution for palette selection
-    RandInt colorDist(0, static_cast<int>(palette.size()) - 1);
+// Writes p50, p99 and max of `ms` to out[first..first + 2]; sorts `ms`
+void storePercentiles(std::vector<double> &ms, ScenarioValues &out, int first) {
+    std::sort(ms.begin(), ms.end());
+    out[first] = ms[ms.size() / 2];
+    out[first + 1] = ms[std::min(ms.size() - 1, ms.size() * 99 / 100)];
+    out[first + 2] = ms.back();
+}
 
-    for (size_t i = 0; i < enemies.size(); ++i) {
-        enemies[i].y = 1.2 + i * 0.5;
-        enemies[i].x = lanes[laneDist(gen)];
-        const auto &c = palette[colorDist(gen)];
-        enemies[i].r = c[0];
-        enemies[i].g = c[1];
-        enemies[i].b = c[2];
-        enemies[i].type = static_cast<CarType>(typeDist(gen));
-        enemies[i].active = true;
+// Budget line for `name`: the name followed by one value per metric. False if the file has no such line.
+bool readScenarioBudget(const char *path, const char *name, ScenarioValues &budget) {
+    FILE *f = std::fopen(path, "r");
+    if (f == nullptr) return false;
+    char line[256];
+    bool found = false;
+    while (!found && std::fgets(line, sizeof(line), f) != nullptr) {
+        static_assert(SCENARIO_METRIC_COUNT == 8, "one %lf per metric");
+        char lineName[64];
+        auto &b = budget;
+        found = std::sscanf(line, "%63s %lf %lf %lf %lf %lf %lf %lf %lf", lineName, &b[0], &b[1], &b[2], &b[3],
+                            &b[4], &b[5], &b[6], &b[7]) == SCENARIO_METRIC_COUNT + 1 &&
+                std::strcmp(lineName, name) == 0;
     }
+    std::fclose(f);
+    return found;
 }
 
-void drawEnemies() {
-    for (const auto &enemy : enemies) {
-        if (enemy.active) {
-            drawCar(enemy.x, enemy.y, enemy.r, enemy.g, enemy.b, enemy.type);
-        }
+// Seed and set up the named scenario; nullptr, after listing the names, if there is none
+const Scenario *startScenario(const char *name) {
+    const Scenario *sc = nullptr;
+    for (const Scenario &s : SCENARIOS) {
+        if (std::strcmp(s.name, name) == 0) sc = &s;
+    }
+    if (sc == nullptr) {
+        std::cerr << "unknown scenario " << name << "; one of:";
+        for (const Scenario &s : SCENARIOS) std::cerr << ' ' << s.name;
+        std::cerr << "\n";
+        return nullptr;
     }
-}
 
-bool checkCollision(double x1, double y1, double x2, double y2) {
-    if (!isCollisionEnabled) return false;
-    return (std::abs(x1 - x2) * 2 < (2 * carWidth) * 1.06) && (std::abs(y1 - y2) * 2 < (2 * carHeight) * 1.06);
+    seedSession(SCENARIO_SEED);
+    enemyCount = sc->enemies;
+    currentScenery = sc->scenery;
+    scenerayIntervalMS = sc->sceneryIntervalMs;
+    isCollisionEnabled = sc->collisions;
+    lodController.level = static_cast<int>(LOD_LEVELS.size()) - 1;
+    rq.headless = true;
+    init();
+    return sc;
 }
 
-void updateEnemies() {
-    if (gameFinished) return; // Stop updating enemies once the game is finished
+// Exit code: 0 when every metric is within budget (or no budgets file was given), 1 otherwise
+int runScenario(const char *name, const char *budgetsPath) {
+    const Scenario *sc = startScenario(name);
+    if (sc == nullptr) return 1;
+    ScenarioValues budget{};
+    if (budgetsPath != nullptr && !readScenarioBudget(budgetsPath, name, budget)) {
+        std::cerr << "no budget for " << name << " in " << budgetsPath << "\n";
+        return 1;
+    }
 
-    for (auto &enemy : enemies) {
-        if (!enemy.active) continue;
-        enemy.y -= 0.01;
-        if (enemy.y < -1.4) {
-            enemy.y = 1.4;
-            enemy.x = lanes[laneDist(gen)];
+    std::vector<double> frameMs, tickMs;
+    frameMs.reserve(SCENARIO_TICKS);
+    tickMs.reserve(SCENARIO_TICKS);
+    uint64_t allocations = 0;
+    for (uint32_t t = 0; t < SCENARIO_TICKS; ++t) {
+        uint64_t allocStart = threadHeapAllocations;
+        auto start = std::chrono::steady_clock::now();
+        if (sc->explosionTicks > 0 && t % sc->explosionTicks == 0) {
+            createExplosion(std::sin(t * 0.1) * margin, std::cos(t * 0.07) * 0.8);
         }
+        simulateTick({scenarioInput(t)});
+        auto ticked = std::chrono::steady_clock::now();
+        frameArena.reset();
+        drawWorld();
+        auto drawn = std::chrono::steady_clock::now();
+
+        // warm-up ticks fill the caches and grow buffers to their high-water marks
+        if (t < SCENARIO_WARMUP_TICKS) continue;
+        tickMs.push_back(std::chrono::duration<double, std::milli>(ticked - start).count());
+        frameMs.push_back(std::chrono::duration<double, std::milli>(drawn - ticked).count());
+        allocations += threadHeapAllocations - allocStart;
+    }
 
-        if (checkCollision(playerX, playerY, enemy.x, enemy.y)) {
-            // Create explosion at collision point
-            double explosionX = (playerX + enemy.x) / 2.0;
-            double explosionY = (playerY + enemy.y) / 2.0;
-            createExplosion(explosionX, explosionY);
-
-            // reset game
-            std::cout << "Game Over!!\n";
-            gameOver = true;
-            break;
+    ScenarioValues measured{};
+    storePercentiles(frameMs, measured, FRAME_P50);
+    storePercentiles(tickMs, measured, TICK_P50);
+    measured[PEAK_RSS_MB] = peakRssBytes() / (1024.0 * 1024.0);
+    measured[ALLOCS_PER_FRAME] = static_cast<double>(allocations) / frameMs.size();
+
+    std::printf("scenario %s: %zu frames measured after %u warm-up ticks\n", name, frameMs.size(),
+                SCENARIO_WARMUP_TICKS);
+    int failures = 0;
+    for (int m = 0; m < SCENARIO_METRIC_COUNT; ++m) {
+        if (m == ALLOCS_PER_FRAME && !COUNTS_ALLOCATIONS) {
+            std::printf("  %-17s not counted in this build\n", SCENARIO_METRIC_NAMES[m]);
+            continue;
+        }
+        std::printf("  %-17s %10.3f", SCENARIO_METRIC_NAMES[m], measured[m]);
+        if (budgetsPath != nullptr) {
+            bool over = measured[m] > budget[m];
+            failures += over;
+            std::printf("  budget %10.3f%s", budget[m], over ? "  OVER BUDGET" : "");
         }
+        std::printf("\n");
     }
+    return failures == 0 ? 0 : 1;
 }
 
-// #endregion Enemy
-
-void resetGame() {
-    playerX = 0.0;
-    playerY = -0.75;
-    gameOver = false;
-    paused = false;
-    score = 0;
-    laneOffset = 0;
-    initEnemies();
-    // Reset the start time so start/finish lines schedule restarts as well
-    gameStartTimeMs = glutGet(GLUT_ELAPSED_TIME);
-
-    // Reset non-wrapping scroll anchors so lines don't reappear on laneOffset wrap
-    roadScroll = 0.0;
-    startScroll0 = roadScroll;
-    finishLineSpawned = false;
-    finishScroll0 = 0.0;
-}
-
-void drawGameOverOverlay() {
-    drawText(-0.3, 0.05, "GAME OVER");
-    glColor3d(1, 1, 1);
-    drawText(-0.4, -0.05, "Press Enter to Restart");
+// `--scenario-hash <name> [expected]` simulates a scenario without drawing it and prints the stateHash it ends in.
+// Exit code: 1 when an expected hash (hex) is given and differs. Fixed-point builds must end in the same state on
+// every machine, so their tests pin the values.
+int scenarioHash(const char *name, const char *expected) {
+    const Scenario *sc = startScenario(name);
+    if (sc == nullptr) return 1;
+    for (uint32_t t = 0; t < SCENARIO_TICKS; ++t) {
+        if (sc->explosionTicks > 0 && t % sc->explosionTicks == 0) {
+            createExplosion(std::sin(t * 0.1) * margin, std::cos(t * 0.07) * 0.8);
+        }
+        simulateTick({scenarioInput(t)});
+    }
+    Snapshot snap;
+    captureSnapshot(snap);
+    auto hash = static_cast<unsigned long long>(stateHash(snap));
+    std::printf("scenario %s ends in state %016llx\n", name, hash);
+    if (expected != nullptr && hash != std::strtoull(expected, nullptr, 16)) {
+        std::printf("  expected %s\n", expected);
+        return 1;
+    }
+    return 0;
 }
 
-void drawContratulationsOverlay() {
-    glColor3d(1, 0.2, 0.2);
-    drawText(-0.4, 0.05, "CONGRATULATIONS!");
-    glColor3d(1, 1, 1);
-    drawText(-0.5, -0.05, "Press Enter to Play Again");
-}
+// `--observation-check <name>` keeps the live world every few ticks of a scenario, then encodes all of them in one
+// batch over the job system and again one by one, printing both times. Exit code: 1 when any batched observation
+// differs from its one-by-one encoding.
+int checkObservations(const char *name) {
+    const Scenario *sc = startScenario(name);
+    if (sc == nullptr) return 1;
+    const uint32_t worldCount = 64;
+    std::vector<RolloutWorld> worlds;
+    worlds.reserve(worldCount);
+    for (uint32_t t = 0; t < SCENARIO_TICKS; ++t) {
+        if (t % (SCENARIO_TICKS / worldCount) == 0 && worlds.size() < worldCount) worlds.push_back(liveWorld(0));
+        simulateTick({scenarioInput(t)});
+    }
 
-void keyboardNormal(unsigned char key, int x, int y) {
-    if (key == 13 && gameOver) { // Enter key
-        resetGame();
-    } else if (key == 27) { // Esc key
-        exit(0);
-    } else if (key == '1') {
-        currentScenery = SceneryType::GRASS;
-        initScenery(currentScenery);
-    } else if (key == '2') {
-        currentScenery = SceneryType::DESERT;
-        initScenery(currentScenery);
-    } else if (key == '3') {
-        currentScenery = SceneryType::RIVER;
-        initScenery(currentScenery);
+    ObservationSpec spec;
+    std::vector<Observation> batched(worlds.size()), single(worlds.size());
+    auto start = std::chrono::steady_clock::now();
+    encodeObservations(worlds.data(), static_cast<uint32_t>(worlds.size()), spec, batched.data());
+    auto encoded = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < worlds.size(); ++i) {
+        encodeObservation(worlds[i], spec, single[i]);
     }
+    auto done = std::chrono::steady_clock::now();
 
-    glutPostRedisplay();
+    size_t mismatches = 0;
+    for (size_t i = 0; i < worlds.size(); ++i) {
+        mismatches += std::memcmp(&batched[i], &single[i], sizeof(Observation)) != 0;
+    }
+    std::printf("observations of %zu %s worlds: batched %.1f us, one by one %.1f us, %zu mismatched\n", worlds.size(),
+                name, std::chrono::duration<double, std::micro>(encoded - start).count(),
+                std::chrono::duration<double, std::micro>(done - encoded).count(), mismatches);
+    return mismatches == 0 ? 0 : 1;
 }
 
-void init() {
-    initScenery(currentScenery);
-    initRoad();
-    initEnemies();
-    initBridge();
-    initExplosion();
-    gameStartTimeMs = glutGet(GLUT_ELAPSED_TIME);
-    // Initialize non-wrapping scroll anchors so lines don't reappear on laneOffset wrap
-    roadScroll = 0.0;
-    startScroll0 = roadScroll;
-    finishLineSpawned = false;
+// Replay round trip: `--replay-check <file>` plays the baseline script, changing parameters part-way, while
+// recording it to <file>, then replays the file from the start and again from a seek past the change. Exit code:
+// 0 when both replays end in the state the live run ended in, 1 otherwise.
+int checkReplay(const char *path) {
+    seedSession(SCENARIO_SEED);
+    rq.headless = true;
+    init();
+    replayRecorder.start();
+    for (uint32_t t = 0; t < SCENARIO_TICKS; ++t) {
+        if (t == SCENARIO_TICKS / 3) {
+            TuningValues v = currentTuning();
+            v.roadWidth *= 1.5;
+            v.enemySpeed *= 1.5;
+            if (applyTuning(v)) replayRecorder.recordTuning();
+        }
+        uint8_t input = scenarioInput(t);
+        replayRecorder.recordTick(input);
+        simulateTick({input});
+    }
+    replayRecorder.save(path);
+    replayRecorder.active = false;
+    Snapshot snap;
+    captureSnapshot(snap);
+    uint64_t live = stateHash(snap);
+
+    if (!replayPlayer.open(path)) {
+        std::cerr << "cannot read back " << path << "\n";
+        return 1;
+    }
+    int failures = 0;
+    for (uint32_t seekTick : {0u, SCENARIO_TICKS / 2}) {
+        replayPlayer.seek(seekTick);
+        while (!replayPlayer.finished()) {
+            simulateTick({replayPlayer.nextInput()});
+        }
+        captureSnapshot(snap);
+        uint64_t replayed = stateHash(snap);
+        failures += replayed != live;
+        std::printf("replay from tick %u: state %016llx, live run %016llx%s\n", seekTick,
+                    static_cast<unsigned long long>(replayed), static_cast<unsigned long long>(live),
+                    replayed != live ? "  MISMATCH" : "");
+    }
+    return failures == 0 ? 0 : 1;
 }
 
-void display() {
-    glClearColor(0.53, 0.81, 0.92, 1);
-    glClear(GL_COLOR_BUFFER_BIT);
-
-    drawScenery();
-    drawRoad();
-    drawCar(playerX, playerY, 0.2, 0.3, 0.9);
-    drawEnemies();
-    drawBridge();
-    drawExplosion();
-    drawScore();
-    drawTimer();
+// #endregion Scenario
 
-    if (gameOver) {
-        drawGameOverOverlay();
+int main(int argc, char **argv) {
+    if (argc >= 3 && std::strcmp(argv[1], "--telemetry-csv") == 0) {
+        return telemetryToCsv(argv[2], argc >= 4 ? argv[3] : nullptr);
     }
-
-    if (gameFinished) {
-        drawContratulationsOverlay();
+    if (argc >= 3 && std::strcmp(argv[1], "--spectate") == 0) {
+        return runSpectatorViewer(argc, argv, argv[2]);
     }
-
-    glFlush();
-}
-
-void keyboardSpecial(int key, int x, int y) {
-    if (key == GLUT_KEY_LEFT && playerX > -margin) {
-        playerX -= margin / 10;
-    } else if (key == GLUT_KEY_RIGHT && playerX < margin) {
-        playerX += margin / 10;
-    } else if (key == GLUT_KEY_UP && playerY < 1.0) {
-        playerY += 0.05;
-    } else if (key == GLUT_KEY_DOWN && playerY > -1.0) {
-        playerY -= 0.05;
+    if (argc >= 2 && std::strcmp(argv[1], "--params") == 0) {
+        return tuneParameters(argc - 2, argv + 2);
+    }
+    jobs.start(static_cast<int>(std::max(1u, std::thread::hardware_concurrency())) - 1);
+    if (argc >= 3 && std::strcmp(argv[1], "--scenario") == 0) {
+        return runScenario(argv[2], argc >= 4 ? argv[3] : nullptr);
+    }
+    if (argc >= 3 && std::strcmp(argv[1], "--scenario-hash") == 0) {
+        return scenarioHash(argv[2], argc >= 4 ? argv[3] : nullptr);
+    }
+    if (argc >= 3 && std::strcmp(argv[1], "--observation-check") == 0) {
+        return checkObservations(argv[2]);
+    }
+    if (argc >= 3 && std::strcmp(argv[1], "--replay-check") == 0) {
+        return checkReplay(argv[2]);
     }
 
-    glutPostRedisplay();
-}
-
-void update(int value) {
-    if (!gameOver && !gameFinished) {
-        autoSwitchScenery();
-        updateScenery();
-        updateRoad();
-        updateBridge();
-        updateEnemies();
-        updateScore();
-
-        // Check if the player has crossed the finish line
-        if (finishLineSpawned && roadScroll - finishScroll0 <= -1.6) {
-            std::cout << "Congratulations! You finished the race!\n";
-            gameFinished = true;
+    // options: --seed <n>, --replay <file> [--seek <tick>], --frame-budget-ms <ms>,
+    //          --autopilot [--autopilot-budget-ms <ms>] (F2 toggles it in game),
+    //          netplay: --players <n> --player <k> [--listen <port>] --peer <a.b.c.d:port> (once per other player,
+    //          in player order), --spectators <port> (serve the screen to `--spectate` viewers),
+    //          --tournament <races> (up to 16 side by side, Tab moves the keyboard between them)
+    uint64_t seed = std::random_device{}();
+    bool seedGiven = false;
+    const char *replayPath = nullptr;
+    uint32_t seekTick = 0;
+    int netPlayers = 1;
+    int netPlayer = 1;
+    uint16_t netPort = NET_DEFAULT_PORT;
+    std::vector<const char *> netPeers;
+    bool autopilotOn = false;
+    int spectatorPort = -1;
+    int tournamentRaces = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--autopilot") == 0) {
+            autopilotOn = true;
+        } else if (i + 1 == argc) {
+            break; // every other option takes a value
+        } else if (std::strcmp(argv[i], "--seed") == 0) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+            seedGiven = true;
+        } else if (std::strcmp(argv[i], "--autopilot-budget-ms") == 0) {
+            autopilot.budgetMs = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--players") == 0) {
+            netPlayers = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--player") == 0) {
+            netPlayer = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--listen") == 0) {
+            netPort = static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--peer") == 0) {
+            netPeers.push_back(argv[++i]);
+        } else if (std::strcmp(argv[i], "--replay") == 0) {
+            replayPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--seek") == 0) {
+            seekTick = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--frame-budget-ms") == 0) {
+            lodController.budgetMs = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--spectators") == 0) {
+            spectatorPort = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--tournament") == 0) {
+            tournamentRaces = std::min(std::max(std::atoi(argv[++i]), 1), MAX_TOURNAMENT_RACES);
         }
     }
+    if (tournamentRaces > 0 && (replayPath != nullptr || netPlayers > 1)) {
+        std::cerr << "a tournament cannot be replayed or played over the network\n";
+        return 1;
+    }
+    if (replayPath != nullptr) {
+        if (!replayPlayer.open(replayPath)) {
+            std::cerr << replayPath << " is not a valid replay\n";
+            return 1;
+        }
+        seed = replayPlayer.header->seed;
+    } else if (netPlayers > 1 && !seedGiven) {
+        std::cerr << "netplay needs the same --seed on every instance\n";
+        return 1;
+    }
+    seedSession(seed);
+    if (replayPath == nullptr && netPlayers > 1 && !netSession.start(netPlayer - 1, netPlayers, netPort, netPeers)) {
+        return 1;
+    }
 
-    updateExplosion();
-
-    glutPostRedisplay();
-    glutTimerFunc(30, update, 0);
-}
-
-int main(int argc, char **argv) {
+    TRACE_THREAD("main");
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB | GLUT_MULTISAMPLE);
     glutInitWindowSize(WIDTH, HEIGHT);
@@ -1283,11 +6541,42 @@ int main(int argc, char **argv) {
     glHint(GL_POLYGON_SMOOTH_HINT, GL_NICEST);
 
     init();
+    if (tournamentRaces > 0) tournament.start(tournamentRaces, seed);
+    if (spectatorPort >= 0 && !spectators.start(static_cast<uint16_t>(spectatorPort))) {
+        std::cerr << "spectators disabled: cannot listen on TCP port " << spectatorPort << "\n";
+    }
+    if (replayPlayer.active) {
+        replayPlayer.seek(seekTick);
+    } else {
+        // peers must agree on the rules, so netplay keeps the built-in parameters; the saved ones apply before
+        // recording starts, so the replay header holds them
+        if (!netSession.active) {
+            if (tuning.open(TUNING_PATH)) {
+                pollTuning();
+            } else {
+                std::cerr << "live parameters disabled: cannot map " << TUNING_PATH << "\n";
+            }
+        }
+        // replays hold a single input stream, so netplay sessions and tournaments are not recorded
+        if (!netSession.active && !tournament.active) replayRecorder.start();
+        autopilot.setEnabled(autopilotOn);
+        if (!results.open(RESULTS_HISTORY_PATH, LEADERBOARD_PATH)) {
+            std::cerr << "results will not be saved: cannot map " << RESULTS_HISTORY_PATH << "\n";
+        }
+        if (!telemetry.start(TELEMETRY_LOG_PATH)) {
+            std::cerr << "telemetry disabled: cannot map " << TELEMETRY_LOG_PATH << "\n";
+        }
+    }
 
     glutDisplayFunc(display);
+    glutReshapeFunc(reshape);
+    glutIgnoreKeyRepeat(1);
     glutSpecialFunc(keyboardSpecial);
+    glutSpecialUpFunc(keyboardSpecialUp);
     glutKeyboardFunc(keyboardNormal);
-    glutTimerFunc(30, update, 0);
+    glutKeyboardUpFunc(keyboardNormalUp);
+    glutWindowStatusFunc(windowStatus);
+    armTick();
 
     glutMainLoop();
     return 0;